@@ -0,0 +1,226 @@
+#include "batch.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <new>
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+  const size_t kPageSize = 4096;
+
+  // a DMG instance should fit in 64 KiB, the rom is not counted as it is shared
+  static_assert(sizeof(Emulator) <= 64 * 1024);
+
+  void pin_to_core(std::thread &thread, size_t core) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+      spdlog::warn("Failed to pin batch worker to core {}", core);
+    }
+#else
+    (void)thread;
+    (void)core;
+#endif
+  }
+}
+
+EmulatorBatch::EmulatorBatch(const BatchConfig &cfg): config{cfg} {
+  config.instances = std::max<size_t>(config.instances, 1);
+  config.downsample = std::max(config.downsample, 1);
+
+  size_t cores = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+  if (config.threads == 0) {
+    config.threads = cores;
+  }
+  config.threads = std::min(config.threads, config.instances);
+
+  stride = (sizeof(Emulator) + kPageSize - 1) / kPageSize * kPageSize;
+  arena.reset(static_cast<std::byte*>(::operator new(stride * config.instances, std::align_val_t { kPageSize })));
+  for (size_t i = 0; i < config.instances; i++) {
+    new (arena.get() + i * stride) Emulator();
+    instance(i).initialize();
+  }
+
+  action_buffer.resize(config.instances, 0);
+  observation_buffer.resize(config.instances * observation_size(), 0);
+  reward_buffer.resize(config.instances * config.reward_addresses.size(), 0);
+
+  spdlog::info("Batch: {} instances on {} threads, {} bytes per instance", config.instances, config.threads,
+               instance_footprint());
+
+  workers.reserve(config.threads);
+  for (size_t i = 0; i < config.threads; i++) {
+    workers.emplace_back(&EmulatorBatch::worker_main, this, i);
+    if (config.pin_threads) {
+      pin_to_core(workers.back(), i % cores);
+    }
+  }
+}
+
+EmulatorBatch::~EmulatorBatch() {
+  {
+    std::lock_guard lock(mutex);
+    shutting_down = true;
+  }
+  start_cv.notify_all();
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  for (size_t i = 0; i < config.instances; i++) {
+    instance(i).cleanup();
+    instance(i).~Emulator();
+  }
+}
+
+void EmulatorBatch::ArenaDeleter::operator()(std::byte *ptr) const {
+  ::operator delete(ptr, std::align_val_t { kPageSize });
+}
+
+void EmulatorBatch::load_rom_bytes(const std::vector<uint8_t> &bytes) {
+  rom = std::make_shared<const Rom>(bytes);
+  uint64_t hash = hash64(bytes);
+  for (size_t i = 0; i < config.instances; i++) {
+    instance(i).load_rom(rom, hash);
+  }
+}
+
+void EmulatorBatch::reset() {
+  for (size_t i = 0; i < config.instances; i++) {
+    instance(i).reset();
+  }
+}
+
+bool EmulatorBatch::step_frames(std::span<const uint8_t> actions, int frames) {
+  if (actions.size() != action_buffer.size()) {
+    spdlog::error("Batch step: got {} actions for {} instances", actions.size(), action_buffer.size());
+    return false;
+  }
+  std::copy(actions.begin(), actions.end(), action_buffer.begin());
+
+  {
+    std::lock_guard lock(mutex);
+    frames_to_run = frames;
+    pending = workers.size();
+    generation++;
+  }
+  start_cv.notify_all();
+
+  std::unique_lock lock(mutex);
+  done_cv.wait(lock, [this] { return pending == 0; });
+  return true;
+}
+
+size_t EmulatorBatch::size() const {
+  return config.instances;
+}
+
+int EmulatorBatch::observation_width() const {
+  return kScreenWidth / config.downsample;
+}
+
+int EmulatorBatch::observation_height() const {
+  return kScreenHeight / config.downsample;
+}
+
+size_t EmulatorBatch::observation_size() const {
+  return observation_width() * observation_height();
+}
+
+std::span<const uint8_t> EmulatorBatch::observations() const {
+  return observation_buffer;
+}
+
+std::span<const uint8_t> EmulatorBatch::rewards() const {
+  return reward_buffer;
+}
+
+Emulator& EmulatorBatch::instance(size_t idx) {
+  return *std::launder(reinterpret_cast<Emulator*>(arena.get() + idx * stride));
+}
+
+size_t EmulatorBatch::instance_footprint() const {
+  return stride;
+}
+
+size_t EmulatorBatch::shared_footprint() const {
+  return rom ? rom->size() : 0;
+}
+
+void EmulatorBatch::worker_main(size_t worker) {
+  // each worker owns a fixed contiguous slice so instances stay warm in its cache
+  size_t per_worker = (config.instances + config.threads - 1) / config.threads;
+  size_t begin = std::min(worker * per_worker, config.instances);
+  size_t end = std::min(begin + per_worker, config.instances);
+
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      start_cv.wait(lock, [&] { return shutting_down || generation != seen; });
+      if (shutting_down) {
+        return;
+      }
+      seen = generation;
+    }
+
+    step_range(begin, end);
+
+    bool last = false;
+    {
+      std::lock_guard lock(mutex);
+      last = --pending == 0;
+    }
+    if (last) {
+      done_cv.notify_one();
+    }
+  }
+}
+
+void EmulatorBatch::step_range(size_t begin, size_t end) {
+  for (size_t idx = begin; idx < end; idx++) {
+    Emulator &emulator = instance(idx);
+    emulator.set_input(action_buffer[idx]);
+
+    for (int frame = 1; frame <= frames_to_run; frame++) {
+      emulator.run_frame(frame == frames_to_run);
+    }
+
+    extract_observation(idx);
+    extract_rewards(idx);
+  }
+}
+
+void EmulatorBatch::extract_observation(size_t idx) {
+  const Framebuffer &framebuffer = instance(idx).framebuffer();
+  uint8_t *out = &observation_buffer[idx * observation_size()];
+
+  int step = config.downsample;
+  int width = observation_width();
+  int height = observation_height();
+  bool grayscale = config.format == ObservationFormat::Grayscale;
+
+  for (int y = 0; y < height; y++) {
+    const uint8_t *row = &framebuffer[y * step * kScreenWidth];
+    for (int x = 0; x < width; x++) {
+      uint8_t shade = row[x * step];
+      *out++ = grayscale ? 255 - shade * 85 : shade;
+    }
+  }
+}
+
+void EmulatorBatch::extract_rewards(size_t idx) {
+  size_t count = config.reward_addresses.size();
+  uint8_t *out = &reward_buffer[idx * count];
+  for (size_t i = 0; i < count; i++) {
+    out[i] = instance(idx).read8(config.reward_addresses[i]);
+  }
+}
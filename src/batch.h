@@ -0,0 +1,91 @@
+#pragma once
+
+#include "emulator.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+enum class ObservationFormat {
+  Shades = 0,
+  Grayscale,
+};
+
+struct BatchConfig {
+  size_t instances = 1;
+  size_t threads = 0;
+  bool pin_threads = true;
+  ObservationFormat format = ObservationFormat::Shades;
+  int downsample = 1;
+  std::vector<uint16_t> reward_addresses;
+};
+
+// Steps many independent emulators running the same rom. Per-step inputs and
+// outputs live in flat arrays indexed by instance so callers can hand them
+// straight to a tensor library, and nothing is allocated after construction.
+class EmulatorBatch {
+public:
+  explicit EmulatorBatch(const BatchConfig &config);
+  ~EmulatorBatch();
+
+  EmulatorBatch(const EmulatorBatch&) = delete;
+  EmulatorBatch& operator=(const EmulatorBatch&) = delete;
+
+  void load_rom_bytes(const std::vector<uint8_t> &bytes);
+  void reset();
+
+  // one pressed-buttons mask per instance, held for all n frames; fails
+  // without stepping anything unless there is exactly one action per instance
+  bool step_frames(std::span<const uint8_t> actions, int frames);
+
+  size_t size() const;
+  int observation_width() const;
+  int observation_height() const;
+  size_t observation_size() const;
+
+  // instances * observation_size() bytes, row major
+  std::span<const uint8_t> observations() const;
+  // instances * reward_addresses.size() bytes
+  std::span<const uint8_t> rewards() const;
+
+  Emulator& instance(size_t idx);
+
+  // bytes owned by each instance, and by the rom shared between all of them
+  size_t instance_footprint() const;
+  size_t shared_footprint() const;
+
+private:
+  void worker_main(size_t worker);
+  void step_range(size_t begin, size_t end);
+  void extract_observation(size_t idx);
+  void extract_rewards(size_t idx);
+
+  struct ArenaDeleter {
+    void operator()(std::byte *ptr) const;
+  };
+
+  BatchConfig config;
+  std::shared_ptr<const Rom> rom;
+
+  // instances are laid out back to back in page aligned slots
+  std::unique_ptr<std::byte[], ArenaDeleter> arena;
+  size_t stride = 0;
+
+  std::vector<uint8_t> action_buffer;
+  std::vector<uint8_t> observation_buffer;
+  std::vector<uint8_t> reward_buffer;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable start_cv;
+  std::condition_variable done_cv;
+  uint64_t generation = 0;
+  size_t pending = 0;
+  int frames_to_run = 0;
+  bool shutting_down = false;
+};
@@ -0,0 +1,288 @@
+#include "capture.h"
+#include "state.h"
+#include "util.h"
+
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace {
+  const size_t kQueueSize = 64;
+  const uint32_t kCaptureMagic = 0x43454341; // "ACEC"
+  const uint32_t kCaptureVersion = 1;
+  const uint32_t kFrameChunk = 0x4D415246; // "FRAM"
+  const uint32_t kKeyframeInterval = 600;
+}
+
+void encode_delta(const Framebuffer &frame, const Framebuffer &previous, std::vector<uint8_t> &out) {
+  StateWriter writer { out };
+  size_t pos = 0;
+  while (pos < frame.size()) {
+    // unchanged runs dominate, so compare them a word at a time
+    uint16_t skip = 0;
+    while (pos + skip + 8 <= frame.size() && skip <= UINT16_MAX - 8 &&
+           std::memcmp(&frame[pos + skip], &previous[pos + skip], 8) == 0) {
+      skip += 8;
+    }
+    while (pos + skip < frame.size() && frame[pos + skip] == previous[pos + skip] && skip < UINT16_MAX) {
+      skip++;
+    }
+    pos += skip;
+
+    // a literal may swallow a few unchanged pixels, taking whole changed
+    // words is cheaper than splitting them into more runs
+    uint16_t literal = 0;
+    while (pos + literal + 8 <= frame.size() && literal <= UINT16_MAX - 8 &&
+           std::memcmp(&frame[pos + literal], &previous[pos + literal], 8) != 0) {
+      literal += 8;
+    }
+    while (pos + literal < frame.size() && frame[pos + literal] != previous[pos + literal] && literal < UINT16_MAX) {
+      literal++;
+    }
+
+    writer.write(skip);
+    writer.write(literal);
+    writer.write_bytes({ &frame[pos], literal });
+    pos += literal;
+  }
+}
+
+bool decode_delta(StateReader &reader, size_t size, Framebuffer &frame) {
+  size_t end = reader.pos + size;
+  size_t pos = 0;
+  while (reader.ok && reader.pos < end) {
+    uint16_t skip = 0;
+    uint16_t literal = 0;
+    reader.read(skip);
+    reader.read(literal);
+    pos += skip;
+    if (pos + literal > frame.size()) {
+      return false;
+    }
+    reader.read_bytes({ &frame[pos], literal });
+    pos += literal;
+  }
+  return reader.ok && reader.pos == end;
+}
+
+FrameCapture::~FrameCapture() {
+  stop();
+}
+
+bool FrameCapture::start(const std::string &path) {
+  stop();
+
+  file.open(path, std::ios::binary);
+  if (!file) {
+    spdlog::error("Failed to open capture file: {}", path);
+    return false;
+  }
+
+  std::vector<uint8_t> header;
+  StateWriter writer { header };
+  writer.write(kCaptureMagic);
+  writer.write(kCaptureVersion);
+  writer.write(static_cast<uint16_t>(kScreenWidth));
+  writer.write(static_cast<uint16_t>(kScreenHeight));
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  if (!file) {
+    spdlog::error("Failed to write capture file: {}", path);
+    file.close();
+    return false;
+  }
+
+  capture_path = path;
+  slots.resize(kQueueSize);
+  renderer.reset(current);
+  vram.fill(0);
+  vram_version = 0;
+  head = 0;
+  tail = 0;
+  frames_written = 0;
+  stalls = 0;
+  failed = false;
+
+  running = true;
+  writer_thread = std::thread(&FrameCapture::writer_main, this);
+
+  spdlog::info("Capturing to {}", path);
+  return true;
+}
+
+bool FrameCapture::stop() {
+  if (!running) {
+    return !failed;
+  }
+
+  running = false;
+  writer_thread.join();
+  file.close();
+  if (!file) {
+    failed = true;
+  }
+
+  if (failed) {
+    spdlog::error("Capture to {} failed, only the first {} frames are complete", capture_path, frames_written);
+    return false;
+  }
+
+  spdlog::info("Captured {} frames ({} stalls waiting on the writer)", frames_written, stalls);
+  return true;
+}
+
+bool FrameCapture::is_active() const {
+  return running;
+}
+
+void FrameCapture::push(const FrameSource &source) {
+  size_t pos = head.load(std::memory_order_relaxed);
+
+  // block rather than drop, a capture with holes is useless for regressions
+  if (pos - tail.load(std::memory_order_acquire) == kQueueSize) [[unlikely]] {
+    stalls++;
+    while (pos - tail.load(std::memory_order_acquire) == kQueueSize) {
+      std::this_thread::yield();
+    }
+  }
+
+  // assigning into the slot reuses its vram storage once the ring has warmed up
+  slots[pos % kQueueSize] = source;
+  head.store(pos + 1, std::memory_order_release);
+}
+
+void FrameCapture::writer_main() {
+  while (true) {
+    // read running before head, so a frame pushed just before stop() is
+    // always seen and drained rather than left in the ring
+    bool stopping = !running.load(std::memory_order_acquire);
+    size_t pos = tail.load(std::memory_order_relaxed);
+    if (pos == head.load(std::memory_order_acquire)) {
+      if (stopping) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    // after a failed write keep consuming so the producer never blocks on a dead writer
+    if (!failed) {
+      draw_frame(slots[pos % kQueueSize]);
+      write_frame(current);
+    }
+    tail.store(pos + 1, std::memory_order_release);
+  }
+
+  file.flush();
+}
+
+void FrameCapture::draw_frame(const FrameSource &source) {
+  // replays the frame the way the ppu drew it, patching vram as it goes
+  size_t patched = 0;
+  size_t page_pos = 0;
+  auto apply_patches = [&] (size_t count) {
+    for (; patched < count; patched++) {
+      const auto &patch = source.patches[patched];
+      for (uint32_t pages = patch.pages; pages; pages &= pages - 1) {
+        std::memcpy(&vram[std::countr_zero(pages) * kVramPageSize], &source.page_bytes[page_pos], kVramPageSize);
+        page_pos += kVramPageSize;
+      }
+      vram_version = patch.version;
+    }
+  };
+
+  for (const auto &line : source.lines) {
+    apply_patches(line.patches);
+    if (line.regs >> 24 & 0x80) {
+      renderer.draw(current, line.line, line.regs, vram.data(), vram_version);
+    } else {
+      renderer.blank(current);
+    }
+  }
+  apply_patches(source.patches.size());
+}
+
+void FrameCapture::write_frame(const Framebuffer &frame) {
+  bool keyframe = frames_written % kKeyframeInterval == 0;
+  if (keyframe) {
+    previous.fill(0);
+  }
+
+  encoded.clear();
+  StateWriter writer { encoded };
+  writer.write(kFrameChunk);
+  writer.write(uint32_t { 0 });
+  writer.write(frames_written);
+  writer.write(static_cast<uint8_t>(keyframe));
+
+  encode_delta(frame, previous, encoded);
+  previous = frame;
+
+  // chunk size covers everything after the tag and size fields
+  uint32_t size = encoded.size() - 2 * sizeof(uint32_t);
+  std::memcpy(&encoded[sizeof(uint32_t)], &size, sizeof(size));
+
+  file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+  if (!file) {
+    spdlog::error("Failed to write frame {} to {}", frames_written, capture_path);
+    failed = true;
+    return;
+  }
+  frames_written++;
+}
+
+bool read_capture(const std::string &path, const std::function<bool(uint32_t, const Framebuffer&)> &on_frame) {
+  auto bytes = read_file_bytes(path);
+  if (!bytes.has_value()) {
+    spdlog::error("Failed to read capture: {}", path);
+    return false;
+  }
+
+  StateReader reader { bytes.value() };
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint16_t width = 0;
+  uint16_t height = 0;
+  reader.read(magic);
+  reader.read(version);
+  reader.read(width);
+  reader.read(height);
+  if (!reader.ok || magic != kCaptureMagic || version != kCaptureVersion ||
+      width != kScreenWidth || height != kScreenHeight) {
+    spdlog::error("Not a supported capture file: {}", path);
+    return false;
+  }
+
+  Framebuffer frame {};
+  size_t count = 0;
+  while (reader.pos < reader.in.size()) {
+    uint32_t tag = 0;
+    uint32_t size = 0;
+    uint32_t index = 0;
+    uint8_t keyframe = 0;
+    reader.read(tag);
+    reader.read(size);
+    if (!reader.ok || tag != kFrameChunk || size < sizeof(index) + sizeof(keyframe)) {
+      spdlog::error("Corrupt capture chunk after {} frames", count);
+      return false;
+    }
+
+    reader.read(index);
+    reader.read(keyframe);
+    if (keyframe) {
+      frame.fill(0);
+    }
+
+    if (!decode_delta(reader, size - sizeof(index) - sizeof(keyframe), frame)) {
+      spdlog::error("Corrupt frame {} in capture", index);
+      return false;
+    }
+
+    if (!on_frame(index, frame)) {
+      return false;
+    }
+    count++;
+  }
+
+  return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ppu.h"
+#include "state.h"
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams every frame to a chunked file from a background thread. Frames go
+// through a single producer, single consumer ring so the emulation thread
+// never takes a lock. They are pushed as what their lines were drawn from,
+// and the writer draws them itself, so capturing costs the emulation thread
+// no rendering. Each frame is stored as runs of pixels that changed since the
+// previous one.
+class FrameCapture {
+public:
+  ~FrameCapture();
+
+  bool start(const std::string &path);
+  // false when any frame failed to reach the file, e.g. on a full disk
+  bool stop();
+  bool is_active() const;
+
+  void push(const FrameSource &source);
+
+private:
+  void writer_main();
+  void draw_frame(const FrameSource &source);
+  void write_frame(const Framebuffer &frame);
+
+  std::vector<FrameSource> slots;
+  std::atomic<size_t> head = 0;
+  std::atomic<size_t> tail = 0;
+  std::atomic<bool> running = false;
+  std::thread writer_thread;
+
+  std::ofstream file;
+  std::string capture_path;
+  std::atomic<bool> failed = false;
+  LineRenderer renderer;
+  Framebuffer current;
+  Vram vram;
+  uint32_t vram_version = 0;
+  Framebuffer previous;
+  std::vector<uint8_t> encoded;
+  uint32_t frames_written = 0;
+  size_t stalls = 0;
+};
+
+// a capture frame is (unchanged count, changed count, changed pixels...) runs
+// against the previous frame until the whole frame is covered
+void encode_delta(const Framebuffer &frame, const Framebuffer &previous, std::vector<uint8_t> &out);
+bool decode_delta(StateReader &reader, size_t size, Framebuffer &frame);
+
+// decodes a capture file, calling on_frame for each frame in order until it returns false
+bool read_capture(const std::string &path, const std::function<bool(uint32_t, const Framebuffer&)> &on_frame);
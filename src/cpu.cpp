@@ -1,12 +1,12 @@
 #include "cpu.h"
+#include "util.h"
 
+#include <utility>
 #include <variant>
 
-template <class... Ts>
-struct overloaded : Ts... { using Ts::operator()...; };
-
-template <class... Ts>
-overloaded(Ts...) -> overloaded<Ts...>;
+namespace {
+  const uint16_t kIOPage = 0xFF00;
+}
 
 void instr_add8(uint8_t &dst, uint8_t &src, Flags &f) {
   dst = dst + src;
@@ -14,34 +14,92 @@ void instr_add8(uint8_t &dst, uint8_t &src, Flags &f) {
   f.set(Flag::N, 0);
 }
 
-void CPU::execute() {
+template <bool kDebug>
+uint8_t& CPU::access(Debugger *debugger, uint16_t address, WatchKind kind) {
+  if constexpr (kDebug) {
+    if (std::to_underlying(kind) & std::to_underlying(WatchKind::Read)) {
+      debugger->on_access(address, false);
+    }
+    if (std::to_underlying(kind) & std::to_underlying(WatchKind::Write)) {
+      debugger->on_access(address, true);
+    }
+  }
+  return memory.at(address, std::to_underlying(kind) & std::to_underlying(WatchKind::Write));
+}
+
+template <bool kDebug>
+int CPU::execute(Debugger *debugger) {
+  if (state.halt || state.hard_lock) {
+    return 4;
+  }
+
+  if constexpr (kDebug) {
+    if (debugger->check_breakpoint(regs)) {
+      return 0;
+    }
+  }
+
   Instruction instr = decoder.decode(&memory, regs.pc);
+  regs.pc += instr.bytes;
+
+  // memory operands resolve to their effective address, which the debug
+  // variant reports to the watchpoints before touching memory
+  auto resolve = [&] (const Operand &operand, WatchKind kind) -> uint8_t* {
+    return std::visit(overloaded {
+        [&] (const Reg8 &reg) -> uint8_t* {
+          if (operand.immediate) {
+            return &regs.at(reg);
+          }
+          // LD [C], A and LD A, [C] address the io page
+          return &access<kDebug>(debugger, kIOPage + regs.get(reg), kind);
+        },
+        [&] (const Reg16 &reg) -> uint8_t* {
+          return operand.immediate ? nullptr : &access<kDebug>(debugger, regs.get(reg), kind);
+        },
+        [&] (const Immediate8 &imm) -> uint8_t* {
+          return operand.immediate ? nullptr : &access<kDebug>(debugger, kIOPage + imm.value, kind);
+        },
+        [&] (const Immediate16 &imm) -> uint8_t* {
+          return operand.immediate ? nullptr : &access<kDebug>(debugger, imm.value, kind);
+        },
+        [] (const auto&) -> uint8_t* { return nullptr; },
+    }, operand.op);
+  };
 
   uint8_t *dst_ptr = nullptr;
   uint8_t *src_ptr = nullptr;
 
-  bool has_operands = instr.operands.has_value();
-  if (has_operands) {
-    auto operands = instr.operands.value();
+  // jump and call targets are addresses, not memory accesses
+  bool branch = instr.opcode == Opcode::JP || instr.opcode == Opcode::CALL || instr.opcode == Opcode::JR;
+  if (instr.operands.has_value() && !branch) {
+    const Operands &operands = instr.operands.value();
 
-    std::visit(overloaded {
-        [&, dst=operands.dst] (const Reg8 &reg) {
-          if (dst.immediate) {
-            dst_ptr = &regs.at(reg);
-          } else {
-            dst_ptr = &memory.at(regs.get(reg));
-          }
-        },
-        [] (auto&) {}
-    }, operands.dst.op);
+    // only loads write a memory destination without reading it first, and
+    // RES/SET modify the [HL] source in place
+    bool load = instr.opcode == Opcode::LD || instr.opcode == Opcode::LDH;
+    bool bit_write = instr.opcode == Opcode::RES || instr.opcode == Opcode::SET;
+    dst_ptr = resolve(operands.dst, load ? WatchKind::Write : WatchKind::ReadWrite);
+    if (operands.src.has_value()) {
+      src_ptr = resolve(operands.src.value(), bit_write ? WatchKind::ReadWrite : WatchKind::Read);
+    }
   }
 
   switch (instr.opcode) {
-  case Opcode::LD: instr_add8(*dst_ptr, *src_ptr, regs.flags);  break;
+  case Opcode::LD:
+  case Opcode::LDH:
+    if (dst_ptr && src_ptr) {
+      instr_add8(*dst_ptr, *src_ptr, regs.flags);
+    }
+    break;
   default:
     break;
   }
+
+  return instr.cycles.a;
 }
 
+template int CPU::execute<false>(Debugger*);
+template int CPU::execute<true>(Debugger*);
+
 void CPU::run() {
 }
@@ -1,22 +1,33 @@
 #pragma once
 
+#include "debugger.h"
 #include "decoder.h"
 #include "registers.h"
 #include "memory.h"
 
 #include <memory>
 
+// flags are bytes rather than bools so any value read from a save state is
+// well defined, load_state() rejects anything but 0 or 1
 struct State {
-  bool ime;
-  bool halt;
-  bool hard_lock;
+  uint8_t ime;
+  uint8_t halt;
+  uint8_t hard_lock;
 };
 
 class CPU {
 public:
-  void execute();
+  // the debug variant checks the debugger's breakpoints and watchpoints,
+  // returns 0 when one hits
+  template <bool kDebug = false>
+  int execute(Debugger *debugger = nullptr);
   void run();
 
+private:
+  // every memory operand goes through here, so watchpoints see the real address
+  template <bool kDebug>
+  uint8_t& access(Debugger *debugger, uint16_t address, WatchKind kind);
+
 public:
   Memory memory;
   Registers regs;
@@ -0,0 +1,245 @@
+#include "debugger.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <spdlog/spdlog.h>
+#include <string_view>
+
+namespace {
+  const std::pair<std::string_view, ConditionTerm::LhsType> kConditionNames[] = {
+    { "a", Reg8::A }, { "f", Reg8::F }, { "b", Reg8::B }, { "c", Reg8::C },
+    { "d", Reg8::D }, { "e", Reg8::E }, { "h", Reg8::H }, { "l", Reg8::L },
+    { "af", Reg16::AF }, { "bc", Reg16::BC }, { "de", Reg16::DE }, { "hl", Reg16::HL },
+    { "zf", Flag::Z }, { "nf", Flag::N }, { "hf", Flag::H }, { "cf", Flag::C },
+    { "sp", StackPointer {} }, { "pc", ProgramCounter {} },
+  };
+
+  const std::pair<std::string_view, CompareOp> kCompareOps[] = {
+    { "==", CompareOp::Equal }, { "!=", CompareOp::NotEqual },
+    { "<=", CompareOp::LessEqual }, { ">=", CompareOp::GreaterEqual },
+    { "<", CompareOp::Less }, { ">", CompareOp::Greater },
+  };
+
+  std::string_view trim(std::string_view str) {
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front()))) {
+      str.remove_prefix(1);
+    }
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back()))) {
+      str.remove_suffix(1);
+    }
+    return str;
+  }
+
+  std::optional<uint16_t> parse_number(std::string_view str) {
+    int base = 10;
+    if (str.starts_with("0x") || str.starts_with("0X")) {
+      str.remove_prefix(2);
+      base = 16;
+    } else if (str.starts_with("$")) {
+      str.remove_prefix(1);
+      base = 16;
+    }
+
+    uint16_t value = 0;
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value, base);
+    if (str.empty() || ec != std::errc {} || ptr != str.data() + str.size()) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  std::optional<ConditionTerm> parse_term(std::string_view str) {
+    size_t op_pos = str.find_first_of("=!<>");
+    std::string name(trim(str.substr(0, op_pos)));
+    std::transform(name.begin(), name.end(), name.begin(), [] (unsigned char ch) { return std::tolower(ch); });
+
+    auto lhs = std::find_if(std::begin(kConditionNames), std::end(kConditionNames),
+                            [&] (const auto &entry) { return entry.first == name; });
+    if (lhs == std::end(kConditionNames)) {
+      return std::nullopt;
+    }
+
+    // a bare name is true when non-zero
+    if (op_pos == std::string_view::npos) {
+      return ConditionTerm { lhs->second, CompareOp::NotEqual, 0 };
+    }
+
+    std::string_view rest = str.substr(op_pos);
+    for (const auto &[token, op] : kCompareOps) {
+      if (rest.starts_with(token)) {
+        auto value = parse_number(trim(rest.substr(token.size())));
+        if (!value.has_value()) {
+          return std::nullopt;
+        }
+        return ConditionTerm { lhs->second, op, value.value() };
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  std::optional<std::vector<ConditionTerm>> parse_condition(std::string_view str) {
+    std::vector<ConditionTerm> terms;
+    if (trim(str).empty()) {
+      return terms;
+    }
+
+    // every && needs a term on both sides
+    while (true) {
+      size_t split = str.find("&&");
+      auto term = parse_term(trim(str.substr(0, split)));
+      if (!term.has_value()) {
+        return std::nullopt;
+      }
+      terms.push_back(term.value());
+      if (split == std::string_view::npos) {
+        return terms;
+      }
+      str = str.substr(split + 2);
+    }
+  }
+
+  uint16_t evaluate_lhs(const ConditionTerm::LhsType &lhs, const Registers &regs) {
+    return std::visit(overloaded {
+        [&] (const Reg8 &reg) -> uint16_t { return regs.get(reg); },
+        [&] (const Reg16 &reg) -> uint16_t { return regs.get(reg); },
+        [&] (const Flag &flag) -> uint16_t { return regs.flags.get(flag); },
+        [&] (const StackPointer&) -> uint16_t { return regs.sp; },
+        [&] (const ProgramCounter&) -> uint16_t { return regs.pc; },
+    }, lhs);
+  }
+
+  bool evaluate(const std::vector<ConditionTerm> &condition, const Registers &regs) {
+    return std::all_of(condition.begin(), condition.end(), [&] (const ConditionTerm &term) {
+      uint16_t lhs = evaluate_lhs(term.lhs, regs);
+      switch (term.op) {
+      case CompareOp::Equal: return lhs == term.value;
+      case CompareOp::NotEqual: return lhs != term.value;
+      case CompareOp::Less: return lhs < term.value;
+      case CompareOp::LessEqual: return lhs <= term.value;
+      case CompareOp::Greater: return lhs > term.value;
+      case CompareOp::GreaterEqual: return lhs >= term.value;
+      default:
+        std::unreachable();
+      }
+    });
+  }
+}
+
+bool Debugger::add_breakpoint(uint16_t address, const std::string &expression) {
+  auto condition = parse_condition(expression);
+  if (!condition.has_value()) {
+    spdlog::warn("Invalid breakpoint condition: {}", expression);
+    return false;
+  }
+
+  breakpoint_list.push_back({ address, expression, condition.value() });
+  rebuild_pages();
+  return true;
+}
+
+void Debugger::remove_breakpoint(size_t idx) {
+  if (idx < breakpoint_list.size()) {
+    breakpoint_list.erase(breakpoint_list.begin() + idx);
+    rebuild_pages();
+  }
+}
+
+const std::vector<Breakpoint>& Debugger::breakpoints() const {
+  return breakpoint_list;
+}
+
+void Debugger::add_watchpoint(uint16_t start, uint16_t end, WatchKind kind) {
+  watchpoint_list.push_back({ std::min(start, end), std::max(start, end), kind });
+  rebuild_pages();
+}
+
+void Debugger::remove_watchpoint(size_t idx) {
+  if (idx < watchpoint_list.size()) {
+    watchpoint_list.erase(watchpoint_list.begin() + idx);
+    rebuild_pages();
+  }
+}
+
+const std::vector<Watchpoint>& Debugger::watchpoints() const {
+  return watchpoint_list;
+}
+
+bool Debugger::armed() const {
+  return !breakpoint_list.empty() || !watchpoint_list.empty();
+}
+
+void Debugger::resume(uint16_t pc) {
+  if (breakpoint_hit) {
+    resume_pc = pc;
+  }
+  clear_hit();
+}
+
+bool Debugger::check_breakpoint(const Registers &regs) {
+  if (!breakpoint_pages[regs.pc >> 8]) {
+    resume_pc.reset();
+    return false;
+  }
+
+  if (resume_pc == regs.pc) {
+    resume_pc.reset();
+    return false;
+  }
+  resume_pc.reset();
+
+  for (const auto &breakpoint : breakpoint_list) {
+    if (breakpoint.address == regs.pc && evaluate(breakpoint.condition, regs)) {
+      hit = true;
+      breakpoint_hit = true;
+      reason = breakpoint.expression.empty()
+        ? fmt::format("Breakpoint at {:04X}", regs.pc)
+        : fmt::format("Breakpoint at {:04X} ({})", regs.pc, breakpoint.expression);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool Debugger::triggered() const {
+  return hit;
+}
+
+const std::string& Debugger::hit_reason() const {
+  return reason;
+}
+
+void Debugger::clear_hit() {
+  hit = false;
+  breakpoint_hit = false;
+  reason.clear();
+}
+
+void Debugger::check_watchpoints(uint16_t address, bool write) {
+  WatchKind kind = write ? WatchKind::Write : WatchKind::Read;
+  for (const auto &watchpoint : watchpoint_list) {
+    bool in_range = address >= watchpoint.start && address <= watchpoint.end;
+    if (in_range && (std::to_underlying(watchpoint.kind) & std::to_underlying(kind))) {
+      hit = true;
+      reason = fmt::format("{} watchpoint at {:04X}", write ? "Write" : "Read", address);
+      return;
+    }
+  }
+}
+
+void Debugger::rebuild_pages() {
+  breakpoint_pages.reset();
+  for (const auto &breakpoint : breakpoint_list) {
+    breakpoint_pages.set(breakpoint.address >> 8);
+  }
+
+  watch_pages.reset();
+  for (const auto &watchpoint : watchpoint_list) {
+    for (int page = watchpoint.start >> 8; page <= watchpoint.end >> 8; page++) {
+      watch_pages.set(page);
+    }
+  }
+}
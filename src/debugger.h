@@ -0,0 +1,95 @@
+#pragma once
+
+#include "instructions.h"
+#include "registers.h"
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+struct ProgramCounter {};
+
+enum class CompareOp {
+  Equal = 0,
+  NotEqual,
+  Less,
+  LessEqual,
+  Greater,
+  GreaterEqual,
+};
+
+struct ConditionTerm {
+  using LhsType = std::variant<Reg8, Reg16, Flag, StackPointer, ProgramCounter>;
+
+  LhsType lhs;
+  CompareOp op;
+  uint16_t value;
+};
+
+struct Breakpoint {
+  uint16_t address;
+  std::string expression;
+  std::vector<ConditionTerm> condition;
+};
+
+enum class WatchKind {
+  Read = 1,
+  Write = 2,
+  ReadWrite = 3,
+};
+
+struct Watchpoint {
+  uint16_t start;
+  uint16_t end;
+  WatchKind kind;
+};
+
+// Breakpoints are only checked by the debug variant of CPU::execute, which the
+// emulator swaps in while armed() is true. Per-page bits keep the checks on
+// that path down to one bit test for addresses nowhere near a breakpoint.
+class Debugger {
+public:
+  // condition is a list of terms joined by &&, e.g. "a == 0x10 && zf"
+  bool add_breakpoint(uint16_t address, const std::string &condition = "");
+  void remove_breakpoint(size_t idx);
+  const std::vector<Breakpoint>& breakpoints() const;
+
+  void add_watchpoint(uint16_t start, uint16_t end, WatchKind kind);
+  void remove_watchpoint(size_t idx);
+  const std::vector<Watchpoint>& watchpoints() const;
+
+  bool armed() const;
+
+  // when stopped on a breakpoint, skip it once so resuming does not hit it
+  // again; a watchpoint stops after its instruction so nothing is skipped
+  void resume(uint16_t pc);
+
+  bool check_breakpoint(const Registers &regs);
+
+  inline void on_access(uint16_t address, bool write) {
+    if (watch_pages[address >> 8]) [[unlikely]] {
+      check_watchpoints(address, write);
+    }
+  }
+
+  bool triggered() const;
+  const std::string& hit_reason() const;
+  void clear_hit();
+
+private:
+  void check_watchpoints(uint16_t address, bool write);
+  void rebuild_pages();
+
+  std::vector<Breakpoint> breakpoint_list;
+  std::vector<Watchpoint> watchpoint_list;
+  std::bitset<256> breakpoint_pages;
+  std::bitset<256> watch_pages;
+
+  std::optional<uint16_t> resume_pc;
+  bool hit = false;
+  bool breakpoint_hit = false;
+  std::string reason;
+};
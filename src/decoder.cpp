@@ -9,7 +9,7 @@
 #include <unordered_map>
 #include <utility>
 
-static Instruction decode_prefixed(Memory *memory, uint8_t addr) {
+static Instruction decode_prefixed(const Memory *memory, uint16_t addr) {
   uint8_t op = memory->get8(addr);
 
   int r8 = op & 0x7;
@@ -70,7 +70,7 @@ static Instruction decode_prefixed(Memory *memory, uint8_t addr) {
   return { Opcode::Invalid, 1, 4, std::nullopt };
 }
 
-Instruction Decoder::decode(Memory *memory, uint8_t addr) {
+Instruction Decoder::decode(const Memory *memory, uint16_t addr) {
   uint8_t op = memory->get8(addr);
   uint8_t n8 = memory->get8(addr + 1);
   uint8_t hi = memory->get8(addr + 2);
@@ -11,5 +11,5 @@ class Memory;
 
 class Decoder {
 public:
-  Instruction decode(Memory *memory, uint8_t addr);
+  Instruction decode(const Memory *memory, uint16_t addr);
 };
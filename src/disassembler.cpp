@@ -0,0 +1,95 @@
+#include "disassembler.h"
+#include "util.h"
+
+#include <magic_enum.hpp>
+#include <spdlog/spdlog.h>
+#include <variant>
+
+static std::string format_operand(const Operand &operand) {
+  std::string text = std::visit(overloaded {
+      [&] (const Reg8 &reg) { return std::string(magic_enum::enum_name(reg)); },
+      [&] (const Reg16 &reg) {
+        std::string name(magic_enum::enum_name(reg));
+        if (operand.offset > 0) {
+          name += "+";
+        } else if (operand.offset < 0) {
+          name += "-";
+        }
+        return name;
+      },
+      [] (const Cond &cond) { return std::string(magic_enum::enum_name(cond)); },
+      [] (const Immediate8 &imm) { return fmt::format("${:02X}", imm.value); },
+      [] (const Immediate16 &imm) { return fmt::format("${:04X}", imm.value); },
+      [] (const ImmediateS8 &imm) { return fmt::format("{:+d}", imm.value); },
+      [&] (const StackPointer&) {
+        return operand.offset ? fmt::format("SP{:+d}", operand.offset) : std::string("SP");
+      },
+  }, operand.op);
+
+  return operand.immediate ? text : fmt::format("[{}]", text);
+}
+
+std::string format_instruction(const Instruction &instr) {
+  std::string text(magic_enum::enum_name(instr.opcode));
+  if (instr.operands.has_value()) {
+    text += " " + format_operand(instr.operands->dst);
+    if (instr.operands->src.has_value()) {
+      text += ", " + format_operand(instr.operands->src.value());
+    }
+  }
+  return text;
+}
+
+const std::vector<DisassemblyLine>& Disassembler::disassemble(const Memory &memory, uint16_t start, size_t count) {
+  checked.fill(false);
+  result.clear();
+
+  uint16_t address = start;
+  for (size_t i = 0; i < count; i++) {
+    Page &page = page_for(memory, address);
+    auto &line = page.lines[address % kPageSize];
+    if (!line.has_value()) {
+      Instruction instr = decoder.decode(&memory, address);
+      line = DisassemblyLine { address, static_cast<uint8_t>(instr.bytes), format_instruction(instr) };
+    }
+
+    result.push_back(line.value());
+    address += line->length;
+  }
+
+  return result;
+}
+
+void Disassembler::invalidate() {
+  for (auto &page : pages) {
+    page.reset();
+  }
+}
+
+Disassembler::Page& Disassembler::page_for(const Memory &memory, uint16_t address) {
+  size_t idx = address / kPageSize;
+  auto &page = pages[idx];
+  if (!page) {
+    page = std::make_unique<Page>();
+    checked[idx] = false;
+  }
+
+  // compare against the bytes the cached lines were decoded from, once per call
+  if (!checked[idx]) {
+    checked[idx] = true;
+
+    std::array<uint8_t, kPageSize + 2> current;
+    uint16_t base = idx * kPageSize;
+    for (size_t i = 0; i < current.size(); i++) {
+      current[i] = memory.get8(base + i);
+    }
+
+    if (current != page->bytes) {
+      spdlog::trace("Disassembly of page {:02X} invalidated", idx);
+      page->bytes = current;
+      page->lines.fill(std::nullopt);
+    }
+  }
+
+  return *page;
+}
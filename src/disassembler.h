@@ -0,0 +1,43 @@
+#pragma once
+
+#include "decoder.h"
+#include "memory.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct DisassemblyLine {
+  uint16_t address;
+  uint8_t length;
+  std::string text;
+};
+
+std::string format_instruction(const Instruction &instr);
+
+// Decoded lines are cached per 256 byte page and only redone when the bytes
+// backing that page change, so redrawing the same range every frame is cheap.
+class Disassembler {
+public:
+  const std::vector<DisassemblyLine>& disassemble(const Memory &memory, uint16_t start, size_t count);
+  void invalidate();
+
+private:
+  static const int kPageSize = 256;
+
+  struct Page {
+    // an instruction at the end of the page can read two bytes past it
+    std::array<uint8_t, kPageSize + 2> bytes;
+    std::array<std::optional<DisassemblyLine>, kPageSize> lines;
+  };
+
+  Page& page_for(const Memory &memory, uint16_t address);
+
+  Decoder decoder;
+  std::array<std::unique_ptr<Page>, kMemoryMaxSize / kPageSize> pages;
+  std::array<bool, kMemoryMaxSize / kPageSize> checked;
+  std::vector<DisassemblyLine> result;
+};
@@ -1,2 +1,391 @@
 #include "emulator.h"
+#include "capture.h"
+#include "hash.h"
+#include "state.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+namespace {
+  const uint16_t kEntryPoint = 0x0100;
+  const uint16_t kStackTop = 0xFFFE;
+
+  // leave the host some headroom to draw when running unlimited
+  const std::chrono::milliseconds kUnlimitedFrameBudget { 12 };
+}
+
+void Emulator::initialize() {
+  reset();
+}
+
+void Emulator::update() {
+  last_stats = {};
+  if (!playing) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  // a breakpoint or watchpoint stops the batch, run_frame() counts what ran
+  auto stopped = [this] {
+    return !playing || debug.triggered();
+  };
+
+  if (!fast_forward) {
+    run_frame(true);
+  } else if (speed_multiplier == kSpeedUnlimited) {
+    auto deadline = start + kUnlimitedFrameBudget;
+    while (!stopped() && std::chrono::steady_clock::now() < deadline) {
+      run_frame(false);
+    }
+    run_frame(true);
+  } else {
+    frame_debt += speed_multiplier;
+    int frames = static_cast<int>(frame_debt);
+    frame_debt -= frames;
+
+    // only the last frame of the batch is ever shown, so skip drawing the rest
+    for (int i = 1; i < frames && !stopped(); i++) {
+      run_frame(false);
+    }
+    if (frames > 0) {
+      run_frame(true);
+    }
+  }
+
+  last_stats.host_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Emulator::cleanup() {
+}
+
+void Emulator::load_rom_bytes(const std::vector<uint8_t> &bytes) {
+  load_rom(std::make_shared<const Rom>(bytes), hash64(bytes));
+}
+
+void Emulator::load_rom(std::shared_ptr<const Rom> data, uint64_t hash) {
+  spdlog::debug("Loading rom: {} bytes", data->size());
+  rom = std::move(data);
+  rom_checksum = hash;
+  reset();
+}
+
+void Emulator::reset() {
+  cpu.memory.reset();
+  cpu.memory.rom = rom;
+
+  cpu.regs.reset();
+  cpu.regs.pc = kEntryPoint;
+  cpu.regs.sp = kStackTop;
+  cpu.state = {};
+
+  ppu.reset();
+
+  frame_debt = 0.0f;
+  cycle_debt = 0;
+  next_input = 0;
+  new_frame = true;
+
+  restart_recording();
+}
+
+void Emulator::step() {
+  // a single instruction still belongs to a frame, so recordings and captures
+  // only ever see whole frames however they were reached
+  debug.clear_hit();
+  ppu.render = true;
+  begin_frame();
+
+  int cycles = cpu.execute();
+  ppu.step(cpu.memory, cycles);
+  cycle_debt -= cycles;
+
+  if (cycle_debt <= 0) {
+    end_frame(true);
+  }
+  new_frame = true;
+}
+
+void Emulator::play() {
+  if (debug.triggered()) {
+    debug.resume(cpu.regs.pc);
+  }
+  playing = true;
+}
+
+void Emulator::stop() {
+  playing = false;
+}
+
+bool Emulator::is_playing() const {
+  return playing;
+}
+
+void Emulator::run_frame(bool present) {
+  // stay frozen on a breakpoint until play() resumes
+  if (debug.triggered()) {
+    return;
+  }
+
+  ppu.render = present;
+  last_stats.frames++;
+  last_stats.rendered += present;
+  begin_frame();
+
+  // the plain loop stays untouched unless a breakpoint or watchpoint exists
+  if (debug.armed()) {
+    run_cycles<true>();
+  } else {
+    run_cycles<false>();
+  }
+
+  if (debug.triggered()) {
+    spdlog::info("{}", debug.hit_reason());
+    playing = false;
+    new_frame = true;
+  }
+
+  // an interrupted frame is only recorded once play() has finished it
+  if (cycle_debt <= 0) {
+    end_frame(present);
+  }
+}
+
+void Emulator::begin_frame() {
+  // a frame stopped part way by the debugger carries on instead of gaining a
+  // second frame's worth of cycles
+  if (cycle_debt > 0) {
+    return;
+  }
+
+  cycle_debt += kCyclesPerFrame;
+  ppu.record = capture != nullptr;
+  ppu.begin_source();
+
+  // input is latched per frame so a movie replays exactly what the frame saw
+  cpu.memory.joypad = next_input;
+}
+
+void Emulator::end_frame(bool present) {
+  new_frame = new_frame || present;
+
+  if (capture) [[unlikely]] {
+    capture->push(ppu.source);
+  }
+
+  if (recording.has_value()) [[unlikely]] {
+    recording->inputs.push_back(cpu.memory.joypad);
+    if (recording->checksum_interval > 0 && recording->inputs.size() % recording->checksum_interval == 0) {
+      recording->checksums.push_back(state_checksum());
+    }
+  }
+}
+
+template <bool kDebug>
+void Emulator::run_cycles() {
+  int frame_cycles = 0;
+  while (cycle_debt > 0) {
+    int cycles = cpu.execute<kDebug>(&debug);
+    ppu.step(cpu.memory, cycles);
+    cycle_debt -= cycles;
+    frame_cycles += cycles;
+
+    if constexpr (kDebug) {
+      // a watchpoint hit still finishes its instruction, a breakpoint takes no cycles
+      if (debug.triggered()) {
+        break;
+      }
+    }
+  }
+  last_stats.cycles = frame_cycles;
+}
+
+void Emulator::set_fast_forward(bool enabled) {
+  fast_forward = enabled;
+  frame_debt = 0.0f;
+  spdlog::debug("Fast forward: {}", enabled);
+}
+
+void Emulator::toggle_fast_forward() {
+  set_fast_forward(!fast_forward);
+}
+
+bool Emulator::is_fast_forward() const {
+  return fast_forward;
+}
+
+bool Emulator::set_speed(float multiplier) {
+  if (!std::isfinite(multiplier)) {
+    spdlog::error("Invalid speed multiplier: {}", multiplier);
+    return false;
+  }
+  speed_multiplier = std::clamp(multiplier, kSpeedUnlimited, kMaxSpeedMultiplier);
+  return true;
+}
+
+float Emulator::speed() const {
+  return speed_multiplier;
+}
+
+void Emulator::set_input(uint8_t buttons) {
+  next_input = buttons;
+}
+
+uint8_t Emulator::read8(uint16_t address) const {
+  return cpu.memory.get8(address);
+}
+
+Debugger& Emulator::debugger() {
+  return debug;
+}
+
+const Registers& Emulator::registers() const {
+  return cpu.regs;
+}
+
+const State& Emulator::cpu_state() const {
+  return cpu.state;
+}
+
+const Memory& Emulator::memory() const {
+  return cpu.memory;
+}
+
+void Emulator::write8(uint16_t address, uint8_t val) {
+  // edits from the memory panel count as writes for the watchpoints too
+  debug.on_access(address, true);
+  if (debug.triggered()) {
+    spdlog::info("{}", debug.hit_reason());
+    playing = false;
+  }
+  cpu.memory.set8(address, val);
+}
+
+const FrameStats& Emulator::stats() const {
+  return last_stats;
+}
+
+uint64_t Emulator::rom_hash() const {
+  return rom_checksum;
+}
+
+std::vector<uint8_t> Emulator::save_state() const {
+  std::vector<uint8_t> bytes;
+  StateWriter writer { bytes };
+  write_state(writer, true);
+  return bytes;
+}
+
+bool Emulator::load_state(std::span<const uint8_t> bytes) {
+  // a malformed state is only found part way through reading it, so keep the
+  // running machine to put back rather than losing the session
+  std::vector<uint8_t> backup = save_state();
+  if (!read_state(bytes)) {
+    spdlog::error("Invalid save state, keeping the current one");
+    read_state(backup);
+    return false;
+  }
+
+  frame_debt = 0.0f;
+  next_input = cpu.memory.joypad;
+  new_frame = true;
+
+  restart_recording();
+  return true;
+}
+
+bool Emulator::read_state(std::span<const uint8_t> bytes) {
+  StateReader reader { bytes };
+
+  reader.read(cpu.regs.vals);
+  reader.read(cpu.regs.pc);
+  reader.read(cpu.regs.sp);
+  reader.read(cpu.state);
+
+  reader.read(cpu.memory.rom_bank);
+  reader.read(cpu.memory.ram);
+  reader.read(cpu.memory.joypad);
+  cpu.memory.vram_writes++;
+  cpu.memory.vram_dirty = ~0u;
+
+  bool ppu_valid = ppu.load_state(reader);
+  reader.read(cycle_debt);
+
+  // a frame is at most one frame of cycles from done either way
+  bool valid = ppu_valid && cpu.state.ime <= 1 && cpu.state.halt <= 1 && cpu.state.hard_lock <= 1 &&
+               cycle_debt > -kCyclesPerFrame && cycle_debt <= kCyclesPerFrame;
+  return valid && reader.ok && reader.pos == bytes.size();
+}
+
+uint64_t Emulator::state_checksum() {
+  // input is left out so a checksum only reflects what the frame did with it
+  state_buffer.clear();
+  StateWriter writer { state_buffer };
+  write_state(writer, false);
+  return hash64(state_buffer);
+}
+
+void Emulator::write_state(StateWriter &writer, bool include_input) const {
+  writer.write(cpu.regs.vals);
+  writer.write(cpu.regs.pc);
+  writer.write(cpu.regs.sp);
+  writer.write(cpu.state);
+
+  writer.write(cpu.memory.rom_bank);
+  writer.write(cpu.memory.ram);
+  if (include_input) {
+    writer.write(cpu.memory.joypad);
+  }
+
+  ppu.save_state(writer);
+  writer.write(cycle_debt);
+}
+
+void Emulator::start_recording(uint32_t checksum_interval) {
+  recording = Movie {};
+  recording->rom_hash = rom_checksum;
+  recording->initial_state = save_state();
+  recording->checksum_interval = checksum_interval;
+  spdlog::info("Recording movie");
+}
+
+void Emulator::restart_recording() {
+  // a movie replays from a single starting state, so anything that replaces
+  // the machine state starts the recording over from the new one
+  if (!recording.has_value()) {
+    return;
+  }
+  spdlog::warn("Emulator state replaced while recording, discarding {} recorded frames", recording->inputs.size());
+  start_recording(recording->checksum_interval);
+}
+
+std::optional<Movie> Emulator::stop_recording() {
+  std::optional<Movie> movie = std::move(recording);
+  recording.reset();
+  if (movie.has_value()) {
+    movie->final_checksum = state_checksum();
+    spdlog::info("Stopped recording: {} frames", movie->inputs.size());
+  }
+  return movie;
+}
+
+bool Emulator::is_recording() const {
+  return recording.has_value();
+}
+
+void Emulator::set_capture(FrameCapture *target) {
+  capture = target;
+  ppu.restart_source();
+}
+
+bool Emulator::has_new_frame() {
+  bool result = new_frame;
+  new_frame = false;
+  return result;
+}
+
+const Framebuffer& Emulator::framebuffer() const {
+  return ppu.framebuffer;
+}
@@ -1,8 +1,32 @@
 #pragma once
 
 #include "cpu.h"
+#include "debugger.h"
+#include "movie.h"
+#include "ppu.h"
 #include "registers.h"
 
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// speed multiplier of 0 runs as many frames as fit in a host frame
+const float kSpeedUnlimited = 0.0f;
+const float kDefaultFastForwardSpeed = 4.0f;
+const float kMaxSpeedMultiplier = 32.0f;
+
+struct FrameStats {
+  // frames actually run, a breakpoint or watchpoint ends the batch early
+  int frames;
+  // frames that produced pixels, only the last of a fast-forward batch does
+  int rendered;
+  int cycles;
+  double host_ms;
+};
+
+class FrameCapture;
+
 class Emulator {
 public:
   void initialize();
@@ -10,6 +34,8 @@ public:
   void cleanup();
 
   void load_rom_bytes(const std::vector<uint8_t> &bytes);
+  // hash is hash64() of the rom, so emulators sharing one rom only hash it once
+  void load_rom(std::shared_ptr<const Rom> data, uint64_t hash);
 
   void reset();
   void step();
@@ -18,6 +44,74 @@ public:
 
   bool is_playing() const;
 
+  void run_frame(bool present);
+
+  void set_fast_forward(bool enabled);
+  void toggle_fast_forward();
+  bool is_fast_forward() const;
+
+  // clamped to [kSpeedUnlimited, kMaxSpeedMultiplier], non-finite values are rejected
+  bool set_speed(float multiplier);
+  float speed() const;
+
+  void set_input(uint8_t buttons);
+  uint8_t read8(uint16_t address) const;
+
+  Debugger& debugger();
+
+  const Registers& registers() const;
+  const State& cpu_state() const;
+  const Memory& memory() const;
+  void write8(uint16_t address, uint8_t val);
+
+  // work done by the last update(), for the cycle budget display
+  const FrameStats& stats() const;
+
+  uint64_t rom_hash() const;
+  std::vector<uint8_t> save_state() const;
+  // a malformed state is rejected and leaves the machine as it was
+  bool load_state(std::span<const uint8_t> bytes);
+  uint64_t state_checksum();
+
+  // reset() and load_state() restart an active recording from the new state
+  void start_recording(uint32_t checksum_interval = kDefaultChecksumInterval);
+  std::optional<Movie> stop_recording();
+  bool is_recording() const;
+
+  // every completed frame is recorded and pushed while a capture is set, the
+  // capture draws it on its own thread
+  void set_capture(FrameCapture *target);
+
+  bool has_new_frame();
+  const Framebuffer& framebuffer() const;
+
 private:
+  void begin_frame();
+  void end_frame(bool present);
+
+  template <bool kDebug>
+  void run_cycles();
+
+  void write_state(StateWriter &writer, bool include_input) const;
+  bool read_state(std::span<const uint8_t> bytes);
+  void restart_recording();
+
   CPU cpu;
+  PPU ppu;
+  Debugger debug;
+  std::shared_ptr<const Rom> rom;
+  uint64_t rom_checksum = 0;
+
+  std::optional<Movie> recording;
+  FrameCapture *capture = nullptr;
+  std::vector<uint8_t> state_buffer;
+
+  bool playing = false;
+  bool fast_forward = false;
+  bool new_frame = false;
+  float speed_multiplier = kDefaultFastForwardSpeed;
+  float frame_debt = 0.0f;
+  int cycle_debt = 0;
+  uint8_t next_input = 0;
+  FrameStats last_stats = {};
 };
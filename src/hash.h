@@ -0,0 +1,93 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// XXH64, used for rom identity, state checksums and frame hashes
+namespace hash_detail {
+  const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+  const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+  const uint64_t kPrime3 = 0x165667B19E3779F9ull;
+  const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+  const uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+  inline uint64_t read64(const uint8_t *ptr) {
+    uint64_t val;
+    std::memcpy(&val, ptr, sizeof(val));
+    return val;
+  }
+
+  inline uint32_t read32(const uint8_t *ptr) {
+    uint32_t val;
+    std::memcpy(&val, ptr, sizeof(val));
+    return val;
+  }
+
+  inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = std::rotl(acc, 31);
+    return acc * kPrime1;
+  }
+
+  inline uint64_t merge(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * kPrime1 + kPrime4;
+  }
+}
+
+inline uint64_t hash64(std::span<const uint8_t> data, uint64_t seed = 0) {
+  using namespace hash_detail;
+
+  const uint8_t *ptr = data.data();
+  const uint8_t *end = ptr + data.size();
+  uint64_t h;
+
+  if (data.size() >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+
+    for (; ptr + 32 <= end; ptr += 32) {
+      v1 = round(v1, read64(ptr));
+      v2 = round(v2, read64(ptr + 8));
+      v3 = round(v3, read64(ptr + 16));
+      v4 = round(v4, read64(ptr + 24));
+    }
+
+    h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+    h = merge(h, v1);
+    h = merge(h, v2);
+    h = merge(h, v3);
+    h = merge(h, v4);
+  } else {
+    h = seed + kPrime5;
+  }
+
+  h += data.size();
+
+  for (; ptr + 8 <= end; ptr += 8) {
+    h ^= round(0, read64(ptr));
+    h = std::rotl(h, 27) * kPrime1 + kPrime4;
+  }
+
+  if (ptr + 4 <= end) {
+    h ^= read32(ptr) * kPrime1;
+    h = std::rotl(h, 23) * kPrime2 + kPrime3;
+    ptr += 4;
+  }
+
+  for (; ptr < end; ptr++) {
+    h ^= *ptr * kPrime5;
+    h = std::rotl(h, 11) * kPrime1;
+  }
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
@@ -1,18 +1,238 @@
 #include "interface.h"
+#include "capture.h"
+#include "disassembler.h"
 #include "emulator.h"
+#include "joypad.h"
+#include "movie.h"
+#include "palette.h"
+#include "util.h"
 
 #include <raylib.h>
 #include <imgui.h>
+#include <imgui_memory_editor/imgui_memory_editor.h>
+#include <magic_enum.hpp>
 #include <nfd.h>
 #include <rlImGui.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <array>
+#include <utility>
+
 namespace {
   const int kDefaulWindowWidth = 800;
   const int kDefaultWindowHeight = 600;
+  const int kTargetFPS = 60;
   const char* kWindowTitle = "AceBoy - GameBoy Emulator";
 
+  const std::pair<KeyboardKey, Button> kKeyBindings[] = {
+    { KEY_RIGHT, Button::Right },
+    { KEY_LEFT, Button::Left },
+    { KEY_UP, Button::Up },
+    { KEY_DOWN, Button::Down },
+    { KEY_Z, Button::A },
+    { KEY_X, Button::B },
+    { KEY_RIGHT_SHIFT, Button::Select },
+    { KEY_ENTER, Button::Start },
+  };
+
+  const size_t kDisassemblyLines = 32;
+
   Emulator emulator;
+  FrameCapture capture;
+  Texture2D screen_texture;
+  std::array<Color, kScreenWidth * kScreenHeight> screen_pixels;
+
+  // debugger views read from a copy taken once per host frame, never the live core
+  Memory memory_snapshot;
+  std::array<uint8_t, kMemoryMaxSize> memory_view;
+  Disassembler disassembler;
+  MemoryEditor memory_editor;
+  bool follow_pc = true;
+  uint16_t disassembly_address = 0;
+
+  uint16_t breakpoint_address = 0;
+  char breakpoint_condition[64] = "";
+  uint16_t watch_start = 0;
+  uint16_t watch_end = 0;
+  int watch_kind = 2;
+
+  void write_memory(ImU8 *mem, size_t offset, ImU8 val, void *) {
+    mem[offset] = val;
+    emulator.write8(offset, val);
+  }
+
+  void draw_emulation_window() {
+    if (ImGui::Begin("Emulation")) {
+      if (ImGui::Button(emulator.is_playing() ? "Pause" : "Play")) {
+        if (emulator.is_playing()) {
+          emulator.stop();
+        } else {
+          emulator.play();
+        }
+      }
+      ImGui::SameLine();
+      ImGui::BeginDisabled(emulator.is_playing());
+      if (ImGui::Button("Step")) {
+        emulator.step();
+      }
+      ImGui::EndDisabled();
+      ImGui::SameLine();
+      if (ImGui::Button("Reset")) {
+        emulator.reset();
+      }
+
+      bool fast_forward = emulator.is_fast_forward();
+      if (ImGui::Checkbox("Fast forward (Tab)", &fast_forward)) {
+        emulator.set_fast_forward(fast_forward);
+      }
+
+      bool unlimited = emulator.speed() == kSpeedUnlimited;
+      if (ImGui::Checkbox("Unlimited", &unlimited)) {
+        emulator.set_speed(unlimited ? kSpeedUnlimited : kDefaultFastForwardSpeed);
+      }
+
+      if (!unlimited) {
+        float speed = emulator.speed();
+        if (ImGui::SliderFloat("Speed", &speed, 1.0f, kMaxSpeedMultiplier, "%.1fx")) {
+          emulator.set_speed(speed);
+        }
+      }
+    }
+    ImGui::End();
+  }
+
+  void draw_registers_window() {
+    if (ImGui::Begin("Registers")) {
+      const Registers &regs = emulator.registers();
+      const State &state = emulator.cpu_state();
+
+      ImGui::Text("AF %04X   A %02X F %02X", regs.get(Reg16::AF), regs.get(Reg8::A), regs.get(Reg8::F));
+      ImGui::Text("BC %04X   B %02X C %02X", regs.get(Reg16::BC), regs.get(Reg8::B), regs.get(Reg8::C));
+      ImGui::Text("DE %04X   D %02X E %02X", regs.get(Reg16::DE), regs.get(Reg8::D), regs.get(Reg8::E));
+      ImGui::Text("HL %04X   H %02X L %02X", regs.get(Reg16::HL), regs.get(Reg8::H), regs.get(Reg8::L));
+      ImGui::Text("SP %04X", regs.sp);
+      ImGui::Text("PC %04X", regs.pc);
+
+      ImGui::Separator();
+      ImGui::Text("Z %d  N %d  H %d  C %d", regs.flags.get(Flag::Z), regs.flags.get(Flag::N),
+                  regs.flags.get(Flag::H), regs.flags.get(Flag::C));
+      ImGui::Text("IME %d  HALT %d", state.ime, state.halt);
+
+      ImGui::Separator();
+      const FrameStats &stats = emulator.stats();
+      const float host_budget_ms = 1000.0f / kTargetFPS;
+      ImGui::Text("Frames this update: %d (%d drawn)", stats.frames, stats.rendered);
+      ImGui::Text("Cycles: %d / %d", stats.cycles, kCyclesPerFrame);
+      ImGui::ProgressBar(stats.host_ms / host_budget_ms, { -1, 0 },
+                         TextFormat("%.2f / %.2f ms", stats.host_ms, host_budget_ms));
+    }
+    ImGui::End();
+  }
+
+  void draw_disassembly_window() {
+    if (ImGui::Begin("Disassembly")) {
+      ImGui::Checkbox("Follow PC", &follow_pc);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(80);
+      if (ImGui::InputScalar("##address", ImGuiDataType_U16, &disassembly_address, nullptr, nullptr, "%04X",
+                             ImGuiInputTextFlags_CharsHexadecimal)) {
+        follow_pc = false;
+      }
+
+      uint16_t pc = emulator.registers().pc;
+      uint16_t start = follow_pc ? pc : disassembly_address;
+
+      for (const auto &line : disassembler.disassemble(memory_snapshot, start, kDisassemblyLines)) {
+        if (line.address == pc) {
+          ImGui::TextColored({ 1.0f, 0.8f, 0.2f, 1.0f }, "> %04X  %s", line.address, line.text.c_str());
+        } else {
+          ImGui::Text("  %04X  %s", line.address, line.text.c_str());
+        }
+      }
+    }
+    ImGui::End();
+  }
+
+  void draw_breakpoints_window() {
+    if (ImGui::Begin("Breakpoints")) {
+      Debugger &debugger = emulator.debugger();
+
+      if (debugger.triggered()) {
+        ImGui::TextColored({ 1.0f, 0.4f, 0.4f, 1.0f }, "%s", debugger.hit_reason().c_str());
+      }
+
+      ImGui::SetNextItemWidth(60);
+      ImGui::InputScalar("##bp_address", ImGuiDataType_U16, &breakpoint_address, nullptr, nullptr, "%04X",
+                         ImGuiInputTextFlags_CharsHexadecimal);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(160);
+      ImGui::InputTextWithHint("##bp_condition", "a == 0x10 && zf", breakpoint_condition, sizeof(breakpoint_condition));
+      ImGui::SameLine();
+      if (ImGui::Button("Add breakpoint")) {
+        if (debugger.add_breakpoint(breakpoint_address, breakpoint_condition)) {
+          breakpoint_condition[0] = '\0';
+        }
+      }
+
+      for (size_t i = 0; i < debugger.breakpoints().size(); i++) {
+        const Breakpoint &breakpoint = debugger.breakpoints()[i];
+        ImGui::PushID(static_cast<int>(i));
+        if (ImGui::SmallButton("x")) {
+          debugger.remove_breakpoint(i);
+          ImGui::PopID();
+          break;
+        }
+        ImGui::SameLine();
+        ImGui::Text("%04X %s", breakpoint.address, breakpoint.expression.c_str());
+        ImGui::PopID();
+      }
+
+      ImGui::Separator();
+
+      ImGui::SetNextItemWidth(60);
+      ImGui::InputScalar("##wp_start", ImGuiDataType_U16, &watch_start, nullptr, nullptr, "%04X",
+                         ImGuiInputTextFlags_CharsHexadecimal);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(60);
+      ImGui::InputScalar("##wp_end", ImGuiDataType_U16, &watch_end, nullptr, nullptr, "%04X",
+                         ImGuiInputTextFlags_CharsHexadecimal);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(100);
+      ImGui::Combo("##wp_kind", &watch_kind, "Read\0Write\0Read/Write\0");
+      ImGui::SameLine();
+      if (ImGui::Button("Add watchpoint")) {
+        debugger.add_watchpoint(watch_start, watch_end, static_cast<WatchKind>(watch_kind + 1));
+      }
+
+      for (size_t i = 0; i < debugger.watchpoints().size(); i++) {
+        const Watchpoint &watchpoint = debugger.watchpoints()[i];
+        ImGui::PushID(static_cast<int>(1000 + i));
+        if (ImGui::SmallButton("x")) {
+          debugger.remove_watchpoint(i);
+          ImGui::PopID();
+          break;
+        }
+        ImGui::SameLine();
+        ImGui::Text("%04X-%04X %.*s", watchpoint.start, watchpoint.end,
+                    static_cast<int>(magic_enum::enum_name(watchpoint.kind).size()),
+                    magic_enum::enum_name(watchpoint.kind).data());
+        ImGui::PopID();
+      }
+    }
+    ImGui::End();
+  }
+
+  void draw_memory_window() {
+    if (!memory_editor.Open) {
+      return;
+    }
+
+    for (size_t i = 0; i < memory_view.size(); i++) {
+      memory_view[i] = memory_snapshot.get8(i);
+    }
+    memory_editor.DrawWindow("Memory", memory_view.data(), memory_view.size());
+  }
 }
 
 Interface::Interface() {
@@ -33,26 +253,108 @@ Interface::Interface() {
   spdlog::trace("Monitor resolution: {}x{}", monitor_width, monitor_height);
 
   SetExitKey(KEY_NULL);
+  SetTargetFPS(kTargetFPS);
   rlImGuiSetup(true);
 
   while (!IsWindowReady()) {
     // pass
   }
+
+  Image image = GenImageColor(kScreenWidth, kScreenHeight, kShades[0]);
+  screen_texture = LoadTextureFromImage(image);
+  UnloadImage(image);
+
+  emulator.initialize();
+
+  memory_editor.WriteFn = write_memory;
 }
 
 Interface::~Interface() {
   spdlog::info("Cleaning up interface");
+
+  emulator.cleanup();
+  UnloadTexture(screen_texture);
+}
+
+bool Interface::load_rom(const std::string &path) {
+  auto bytes = read_file_bytes(path);
+  if (!bytes.has_value()) {
+    spdlog::error("Failed to read rom: {}", path);
+    return false;
+  }
+
+  emulator.load_rom_bytes(bytes.value());
+  emulator.play();
+  disassembler.invalidate();
+  return true;
+}
+
+bool Interface::set_speed(float multiplier) {
+  return emulator.set_speed(multiplier);
+}
+
+void Interface::set_fast_forward(bool enabled) {
+  emulator.set_fast_forward(enabled);
+}
+
+void Interface::record_movie(const std::string &path) {
+  movie_path = path;
+  emulator.start_recording();
+}
+
+bool Interface::capture_frames(const std::string &path) {
+  if (!capture.start(path)) {
+    return false;
+  }
+  emulator.set_capture(&capture);
+  return true;
 }
 
 void Interface::run() {
   spdlog::info("Running...");
 
   while (!WindowShouldClose()) {
+    if (IsKeyPressed(KEY_TAB)) {
+      emulator.toggle_fast_forward();
+    }
+
+    uint8_t buttons = 0;
+    for (const auto &[key, button] : kKeyBindings) {
+      if (IsKeyDown(key)) {
+        buttons |= button_mask(button);
+      }
+    }
+    emulator.set_input(buttons);
+
+    emulator.update();
+    memory_snapshot = emulator.memory();
+
+    if (emulator.has_new_frame()) {
+      const Framebuffer &framebuffer = emulator.framebuffer();
+      for (size_t i = 0; i < framebuffer.size(); i++) {
+        screen_pixels[i] = kShades[framebuffer[i]];
+      }
+      UpdateTexture(screen_texture, screen_pixels.data());
+    }
+
     BeginDrawing();
     ClearBackground(RAYWHITE);
 
+    float scale = std::min(GetScreenWidth() / static_cast<float>(kScreenWidth),
+                           GetScreenHeight() / static_cast<float>(kScreenHeight));
+    Rectangle src { 0, 0, static_cast<float>(kScreenWidth), static_cast<float>(kScreenHeight) };
+    Rectangle dst { (GetScreenWidth() - kScreenWidth * scale) / 2, (GetScreenHeight() - kScreenHeight * scale) / 2,
+                    kScreenWidth * scale, kScreenHeight * scale };
+    DrawTexturePro(screen_texture, src, dst, { 0, 0 }, 0.0f, WHITE);
+
     rlImGuiBegin();
 
+    draw_emulation_window();
+    draw_registers_window();
+    draw_disassembly_window();
+    draw_breakpoints_window();
+    draw_memory_window();
+
     rlImGuiEnd();
 
 
@@ -61,5 +363,14 @@ void Interface::run() {
     EndDrawing();
   }
 
+  emulator.set_capture(nullptr);
+  capture.stop();
+
+  if (auto movie = emulator.stop_recording()) {
+    if (save_movie(movie.value(), movie_path)) {
+      spdlog::info("Saved movie: {}", movie_path);
+    }
+  }
+
   spdlog::info("Shutting down...");
 }
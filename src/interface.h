@@ -1,9 +1,20 @@
 #pragma once
 
+#include <string>
+
 class Interface {
 public:
   Interface();
   ~Interface();
 
+  bool load_rom(const std::string &path);
+  bool set_speed(float multiplier);
+  void set_fast_forward(bool enabled);
+  void record_movie(const std::string &path);
+  bool capture_frames(const std::string &path);
+
   void run();
+
+private:
+  std::string movie_path;
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+const uint16_t kJoypadAddress = 0xFF00;
+
+// bit positions in the pressed-buttons mask, d-pad in the low nibble and
+// action buttons in the high nibble to match the two JOYP select lines
+enum class Button {
+  Right = 0,
+  Left,
+  Up,
+  Down,
+  A,
+  B,
+  Select,
+  Start,
+};
+
+inline uint8_t button_mask(Button button) {
+  return 1 << std::to_underlying(button);
+}
+
+// JOYP is active low, a cleared select bit enables that group
+inline uint8_t joypad_read(uint8_t select, uint8_t pressed) {
+  uint8_t lines = 0x0f;
+  if (!(select & 0x10)) {
+    lines &= ~(pressed & 0x0f);
+  }
+  if (!(select & 0x20)) {
+    lines &= ~(pressed >> 4);
+  }
+  return 0xc0 | (select & 0x30) | lines;
+}
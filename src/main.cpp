@@ -1,10 +1,18 @@
+#include "capture.h"
+#include "emulator.h"
 #include "interface.h"
+#include "movie.h"
+#include "png.h"
 #include "registers.h"
+#include "regression.h"
+#include "util.h"
 
 #include <argparse/argparse.hpp>
 #include <magic_enum.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+
 static bool set_logging_level(const std::string &level_name) {
   auto level = magic_enum::enum_cast<spdlog::level::level_enum>(level_name);
   if (level.has_value()) {
@@ -14,6 +22,52 @@ static bool set_logging_level(const std::string &level_name) {
   return false;
 }
 
+static int replay(const std::string &rom_path, const std::string &movie_path,
+                  const std::optional<std::string> &capture_path) {
+  auto rom = read_file_bytes(rom_path);
+  if (!rom.has_value()) {
+    spdlog::error("Failed to read rom: {}", rom_path);
+    return 1;
+  }
+
+  auto movie = load_movie(movie_path);
+  if (!movie.has_value()) {
+    return 1;
+  }
+
+  Emulator emulator;
+  emulator.initialize();
+  emulator.load_rom_bytes(rom.value());
+
+  FrameCapture capture;
+  if (capture_path.has_value()) {
+    if (!capture.start(capture_path.value())) {
+      return 1;
+    }
+    emulator.set_capture(&capture);
+  }
+
+  auto result = replay_movie(emulator, movie.value());
+  emulator.set_capture(nullptr);
+  bool captured = capture.stop();
+  emulator.cleanup();
+
+  if (!result.has_value() || !captured) {
+    return 1;
+  }
+
+  spdlog::info("Replayed {} frames in {:.2f}s ({:.0f} fps)", result->frames, result->seconds,
+               result->frames / std::max(result->seconds, 1e-9));
+
+  if (result->desync_frame.has_value()) {
+    spdlog::error("Desync detected at frame {}", result->desync_frame.value());
+    return 1;
+  }
+
+  spdlog::info("Replay matched all {} checksums", movie->checksums.size());
+  return 0;
+}
+
 auto main(int argc, char *argv[]) -> int {
   spdlog::set_level(spdlog::level::info);
 
@@ -24,6 +78,55 @@ auto main(int argc, char *argv[]) -> int {
       .default_value(std::string("info"))
       .nargs(1);
 
+  program.add_argument("--rom")
+      .help("Path to a rom to load and run");
+
+  program.add_argument("--speed")
+      .help(fmt::format("Fast forward speed multiplier up to {}, 0 for unlimited", kMaxSpeedMultiplier))
+      .default_value(kDefaultFastForwardSpeed)
+      .scan<'g', float>();
+
+  program.add_argument("--fast-forward")
+      .help("Start with fast forward enabled")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--record")
+      .help("Record joypad input to a movie file, saved on exit");
+
+  program.add_argument("--replay")
+      .help("Replay a movie headless at full speed and check it for desyncs");
+
+  program.add_argument("--capture")
+      .help("Stream every frame to a capture file");
+
+  program.add_argument("--export-png")
+      .help("Convert a capture file to a PNG sequence in --out");
+
+  program.add_argument("--out")
+      .help("Output directory for --export-png")
+      .default_value(std::string("frames"));
+
+  program.add_argument("--regress")
+      .help("Run the golden framebuffer regression list at this path");
+
+  program.add_argument("--golden")
+      .help("Golden hash file for --regress (default: <list>.golden)");
+
+  program.add_argument("--update-golden")
+      .help("Rewrite the golden hashes instead of checking them")
+      .default_value(false)
+      .implicit_value(true);
+
+  program.add_argument("--diff-dir")
+      .help("Where --regress writes frames that do not match")
+      .default_value(std::string("regress_diff"));
+
+  program.add_argument("--jobs")
+      .help("Number of regression cases to run in parallel, 0 for one per core")
+      .default_value(size_t { 0 })
+      .scan<'u', size_t>();
+
   try {
     program.parse_args(argc, argv);
   } catch (const std::exception &err) {
@@ -42,8 +145,49 @@ auto main(int argc, char *argv[]) -> int {
     return 1;
   }
 
-  // Interface interface;
-  // interface.run();
+  if (auto movie_path = program.present("--replay")) {
+    auto rom = program.present("--rom");
+    if (!rom.has_value()) {
+      std::cerr << "--replay requires --rom" << std::endl;
+      return 1;
+    }
+    return replay(rom.value(), movie_path.value(), program.present("--capture"));
+  }
+
+  if (auto list_path = program.present("--regress")) {
+    RegressionOptions options;
+    options.list_path = list_path.value();
+    options.golden_path = program.present("--golden").value_or(list_path.value() + ".golden");
+    options.diff_dir = program.get("--diff-dir");
+    options.update_golden = program.get<bool>("--update-golden");
+    options.jobs = program.get<size_t>("--jobs");
+    return run_regressions(options) ? 0 : 1;
+  }
+
+  if (auto capture_path = program.present("--export-png")) {
+    return export_capture_png(capture_path.value(), program.get("--out")) ? 0 : 1;
+  }
+
+  if (auto rom = program.present("--rom")) {
+    Interface interface;
+    if (!interface.set_speed(program.get<float>("--speed"))) {
+      return 1;
+    }
+    interface.set_fast_forward(program.get<bool>("--fast-forward"));
+    if (!interface.load_rom(rom.value())) {
+      return 1;
+    }
+    if (auto movie_path = program.present("--record")) {
+      interface.record_movie(movie_path.value());
+    }
+    if (auto capture_path = program.present("--capture")) {
+      if (!interface.capture_frames(capture_path.value())) {
+        return 1;
+      }
+    }
+    interface.run();
+    return 0;
+  }
 
   Registers regs;
   regs.reset();
@@ -1,26 +1,111 @@
 #pragma once
 
+#include "joypad.h"
+
 #include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 const int kMemoryMaxSize = 65536;
+const int kRomBankSize = 0x4000;
+
+const uint16_t kRomEnd = 0x8000;
+const uint16_t kVramEnd = 0xA000;
+const uint16_t kEchoStart = 0xE000;
+const uint16_t kEchoEnd = 0xFE00;
+
+// VRAM, cartridge RAM and WRAM (0x8000-0xDFFF) followed by OAM, IO and HRAM
+// (0xFE00-0xFFFF); echo RAM folds onto WRAM so it takes no space
+const int kRamSize = (kEchoStart - kRomEnd) + (kMemoryMaxSize - kEchoEnd);
+
+using Rom = std::vector<uint8_t>;
 
 struct Memory {
-  std::array<uint8_t, kMemoryMaxSize> bytes;
+  // shared read-only between every instance running the same cartridge
+  std::shared_ptr<const Rom> rom;
+  uint16_t rom_bank = 1;
+
+  std::array<uint8_t, kRamSize> ram;
+  uint8_t joypad = 0;
+  // backs references to bytes that are computed rather than stored
+  uint8_t sink = 0;
+  // bumped on every vram write so the ppu can tell when a line needs redrawing
+  uint32_t vram_writes = 0;
+  // a bit per 256 byte vram page written since the ppu last took a copy of it
+  uint32_t vram_dirty = 0;
+
+  static size_t ram_offset(uint16_t address) {
+    if (address < kEchoStart) {
+      return address - kRomEnd;
+    }
+    if (address < kEchoEnd) {
+      return address - kEchoStart + (0xC000 - kRomEnd);
+    }
+    return address - kEchoEnd + (kEchoStart - kRomEnd);
+  }
+
+  void reset() {
+    rom_bank = 1;
+    ram.fill(0);
+    joypad = 0;
+    vram_writes++;
+    vram_dirty = ~0u;
+  }
+
+  uint8_t rom_byte(uint16_t address) const {
+    size_t offset = address < kRomBankSize ? address : rom_bank * kRomBankSize + (address - kRomBankSize);
+    if (!rom || offset >= rom->size()) {
+      return 0xff;
+    }
+    return (*rom)[offset];
+  }
 
   void set8(uint16_t address, uint8_t val) {
-    bytes[address] = val;
+    if (address < kRomEnd) {
+      // no bank controller yet, rom writes are dropped
+      return;
+    }
+    if (address < kVramEnd) {
+      vram_writes++;
+      vram_dirty |= 1u << ((address - kRomEnd) >> 8);
+    }
+    ram[ram_offset(address)] = val;
   }
 
-  uint8_t get8(uint8_t address) const {
-    return bytes[address];
+  uint8_t get8(uint16_t address) const {
+    if (address < kRomEnd) {
+      return rom_byte(address);
+    }
+    if (address == kJoypadAddress) {
+      return joypad_read(ram[ram_offset(address)], joypad);
+    }
+    return ram[ram_offset(address)];
   }
 
-  uint8_t& at(uint8_t address) {
-    return bytes[address];
+  // rom writes through the reference are dropped, and a JOYP read sees the
+  // pressed buttons while a write still reaches the select bits
+  uint8_t& at(uint16_t address, bool write) {
+    if (address < kRomEnd) {
+      sink = rom_byte(address);
+      return sink;
+    }
+    if (address == kJoypadAddress && !write) {
+      sink = get8(address);
+      return sink;
+    }
+    if (address < kVramEnd && write) {
+      vram_writes++;
+      vram_dirty |= 1u << ((address - kRomEnd) >> 8);
+    }
+    return ram[ram_offset(address)];
   }
 
   void set16(uint16_t address, uint16_t val) {
-    bytes[address] = val >> 8;
-    bytes[address + 1] = val & 0xff;
+    set8(address, val >> 8);
+    set8(address + 1, val & 0xff);
   }
 };
+
+// the packed ram is the whole point, anything else in Memory has to stay small
+static_assert(sizeof(Memory) <= kRamSize + 32);
@@ -0,0 +1,150 @@
+#include "movie.h"
+#include "emulator.h"
+#include "state.h"
+#include "util.h"
+
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+namespace {
+  const uint32_t kMovieMagic = 0x4D454341; // "ACEM"
+  const uint32_t kMovieVersion = 2;
+}
+
+// inputs are stored as runs of (mask, length) since they rarely change per frame
+bool save_movie(const Movie &movie, const std::string &path) {
+  std::vector<uint8_t> bytes;
+  StateWriter writer { bytes };
+
+  writer.write(kMovieMagic);
+  writer.write(kMovieVersion);
+  writer.write(movie.rom_hash);
+
+  writer.write(static_cast<uint32_t>(movie.initial_state.size()));
+  writer.write_bytes(movie.initial_state);
+
+  writer.write(static_cast<uint32_t>(movie.inputs.size()));
+  for (size_t i = 0; i < movie.inputs.size();) {
+    uint8_t mask = movie.inputs[i];
+    uint16_t run = 0;
+    while (i < movie.inputs.size() && movie.inputs[i] == mask && run < std::numeric_limits<uint16_t>::max()) {
+      run++;
+      i++;
+    }
+    writer.write(mask);
+    writer.write(run);
+  }
+
+  writer.write(movie.checksum_interval);
+  writer.write(static_cast<uint32_t>(movie.checksums.size()));
+  for (uint64_t checksum : movie.checksums) {
+    writer.write(checksum);
+  }
+  writer.write(movie.final_checksum);
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    spdlog::error("Failed to open movie for writing: {}", path);
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  return static_cast<bool>(file);
+}
+
+std::optional<Movie> load_movie(const std::string &path) {
+  auto bytes = read_file_bytes(path);
+  if (!bytes.has_value()) {
+    spdlog::error("Failed to read movie: {}", path);
+    return std::nullopt;
+  }
+
+  StateReader reader { bytes.value() };
+  Movie movie;
+
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  reader.read(magic);
+  reader.read(version);
+  if (!reader.ok || magic != kMovieMagic || version != kMovieVersion) {
+    spdlog::error("Not a supported movie file: {}", path);
+    return std::nullopt;
+  }
+
+  reader.read(movie.rom_hash);
+
+  uint32_t state_size = 0;
+  reader.read(state_size);
+  movie.initial_state.resize(reader.ok ? std::min<size_t>(state_size, reader.in.size()) : 0);
+  reader.read_bytes(movie.initial_state);
+
+  uint32_t frames = 0;
+  reader.read(frames);
+  while (reader.ok && movie.inputs.size() < frames) {
+    uint8_t mask = 0;
+    uint16_t run = 0;
+    reader.read(mask);
+    reader.read(run);
+    // checked before inserting, so a small corrupt file cannot claim gigabytes of input
+    if (run > frames - movie.inputs.size()) {
+      spdlog::error("Corrupt input run in movie file: {}", path);
+      return std::nullopt;
+    }
+    movie.inputs.insert(movie.inputs.end(), run, mask);
+  }
+
+  uint32_t checksum_count = 0;
+  reader.read(movie.checksum_interval);
+  reader.read(checksum_count);
+  for (uint32_t i = 0; reader.ok && i < checksum_count; i++) {
+    uint64_t checksum = 0;
+    reader.read(checksum);
+    movie.checksums.push_back(checksum);
+  }
+  reader.read(movie.final_checksum);
+
+  if (!reader.ok || reader.pos != reader.in.size() || movie.inputs.size() != frames) {
+    spdlog::error("Truncated movie file: {}", path);
+    return std::nullopt;
+  }
+
+  return movie;
+}
+
+std::optional<ReplayResult> replay_movie(Emulator &emulator, const Movie &movie) {
+  if (emulator.rom_hash() != movie.rom_hash) {
+    spdlog::error("Movie was recorded with a different rom ({:016x} != {:016x})", movie.rom_hash, emulator.rom_hash());
+    return std::nullopt;
+  }
+
+  if (!emulator.load_state(movie.initial_state)) {
+    spdlog::error("Movie has an invalid initial state");
+    return std::nullopt;
+  }
+
+  ReplayResult result { 0, 0.0, std::nullopt };
+  auto start = std::chrono::steady_clock::now();
+
+  size_t next_checksum = 0;
+  for (uint8_t buttons : movie.inputs) {
+    emulator.set_input(buttons);
+    emulator.run_frame(false);
+    result.frames++;
+
+    if (movie.checksum_interval > 0 && result.frames % movie.checksum_interval == 0 &&
+        next_checksum < movie.checksums.size()) {
+      if (emulator.state_checksum() != movie.checksums[next_checksum++]) {
+        result.desync_frame = result.frames;
+        break;
+      }
+    }
+  }
+
+  if (!result.desync_frame.has_value() && emulator.state_checksum() != movie.final_checksum) {
+    result.desync_frame = result.frames;
+  }
+
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+class Emulator;
+
+const uint32_t kDefaultChecksumInterval = 60;
+
+struct Movie {
+  uint64_t rom_hash = 0;
+  std::vector<uint8_t> initial_state;
+
+  // one pressed-buttons mask per frame
+  std::vector<uint8_t> inputs;
+
+  // state checksum after every checksum_interval frames
+  uint32_t checksum_interval = kDefaultChecksumInterval;
+  std::vector<uint64_t> checksums;
+
+  // state checksum after the last frame, so the tail past the last interval is covered too
+  uint64_t final_checksum = 0;
+};
+
+struct ReplayResult {
+  size_t frames;
+  double seconds;
+  std::optional<size_t> desync_frame;
+};
+
+bool save_movie(const Movie &movie, const std::string &path);
+std::optional<Movie> load_movie(const std::string &path);
+
+// runs headless as fast as possible, stopping at the first mismatched checksum
+std::optional<ReplayResult> replay_movie(Emulator &emulator, const Movie &movie);
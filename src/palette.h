@@ -0,0 +1,10 @@
+#pragma once
+
+#include <raylib.h>
+
+const Color kShades[] = {
+  { 224, 248, 208, 255 },
+  { 136, 192, 112, 255 },
+  { 52, 104, 86, 255 },
+  { 8, 24, 32, 255 },
+};
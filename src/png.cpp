@@ -0,0 +1,53 @@
+#include "png.h"
+#include "capture.h"
+#include "palette.h"
+
+#include <filesystem>
+#include <raylib.h>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+bool write_png(const Framebuffer &frame, const std::string &path) {
+  std::vector<Color> pixels(frame.size());
+  for (size_t i = 0; i < frame.size(); i++) {
+    pixels[i] = kShades[frame[i] & 0x03];
+  }
+
+  Image image {
+    .data = pixels.data(),
+    .width = kScreenWidth,
+    .height = kScreenHeight,
+    .mipmaps = 1,
+    .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+  };
+  if (!ExportImage(image, path.c_str())) {
+    spdlog::error("Failed to write {}", path);
+    return false;
+  }
+  return true;
+}
+
+bool export_capture_png(const std::string &capture_path, const std::string &out_dir) {
+  std::error_code ec;
+  std::filesystem::create_directories(out_dir, ec);
+  if (ec) {
+    spdlog::error("Failed to create {}: {}", out_dir, ec.message());
+    return false;
+  }
+
+  size_t count = 0;
+  bool ok = read_capture(capture_path, [&] (uint32_t index, const Framebuffer &frame) {
+    auto path = std::filesystem::path(out_dir) / fmt::format("frame_{:06d}.png", index);
+    if (!write_png(frame, path.string())) {
+      return false;
+    }
+    count++;
+    return true;
+  });
+  if (!ok) {
+    return false;
+  }
+
+  spdlog::info("Exported {} frames to {}", count, out_dir);
+  return true;
+}
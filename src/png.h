@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ppu.h"
+
+#include <string>
+
+// PNG output lives outside the core library so headless users do not need raylib
+
+bool write_png(const Framebuffer &frame, const std::string &path);
+
+// writes every frame of a capture as a numbered PNG into out_dir
+bool export_capture_png(const std::string &capture_path, const std::string &out_dir);
@@ -0,0 +1,225 @@
+#include "ppu.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+  const uint16_t kRegIF = 0xFF0F;
+  const uint16_t kRegLCDC = 0xFF40;
+  const uint16_t kRegSTAT = 0xFF41;
+  const uint16_t kRegSCY = 0xFF42;
+  const uint16_t kRegSCX = 0xFF43;
+  const uint16_t kRegLY = 0xFF44;
+  const uint16_t kRegLYC = 0xFF45;
+  const uint16_t kRegBGP = 0xFF47;
+
+  const int kOAMScanDots = 80;
+  const int kDrawDots = 172;
+
+  const int kTileSize = 8;
+  const int kTileMapWidth = 32;
+
+  // moves bit n of a tile row byte to bit 2n, so both bitplanes of a row
+  // combine into eight 2 bit colors with a single or
+  const std::array<uint16_t, 256> kSpreadBits = [] {
+    std::array<uint16_t, 256> table {};
+    for (int byte = 0; byte < 256; byte++) {
+      for (int bit = 0; bit < 8; bit++) {
+        table[byte] |= ((byte >> bit) & 1) << (bit * 2);
+      }
+    }
+    return table;
+  }();
+}
+
+void LineRenderer::reset(Framebuffer &framebuffer) {
+  framebuffer.fill(0);
+  line_keys.fill(0);
+  is_blank = true;
+  shade_quads_bgp = -1;
+}
+
+void LineRenderer::blank(Framebuffer &framebuffer) {
+  if (is_blank) {
+    return;
+  }
+  framebuffer.fill(0);
+  line_keys.fill(0);
+  is_blank = true;
+}
+
+void LineRenderer::draw(Framebuffer &framebuffer, uint8_t line, uint32_t regs, const uint8_t *vram,
+                        uint32_t vram_version) {
+  uint8_t *row = &framebuffer[line * kScreenWidth];
+  uint8_t lcdc = regs >> 24;
+  uint8_t scy = regs >> 16;
+  uint8_t scx = regs >> 8;
+  uint8_t bgp = regs;
+
+  // a line is only drawn while the lcd is on, so a valid key is never 0
+  uint64_t key = static_cast<uint64_t>(vram_version) << 32 | regs;
+  if (line_keys[line] == key) {
+    return;
+  }
+  line_keys[line] = key;
+  is_blank = false;
+
+  // background only, window and sprites are not implemented yet
+  if (!(lcdc & 0x01)) {
+    std::fill(row, row + kScreenWidth, 0);
+    return;
+  }
+
+  uint16_t map_base = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+  bool unsigned_tiles = lcdc & 0x10;
+
+  if (bgp != shade_quads_bgp) {
+    for (int quad = 0; quad < 256; quad++) {
+      for (int px = 0; px < 4; px++) {
+        shade_quads[quad][px] = (bgp >> (((quad >> ((3 - px) * 2)) & 0x03) * 2)) & 0x03;
+      }
+    }
+    shade_quads_bgp = bgp;
+  }
+
+  // decode whole tiles into a line one tile wider than the screen, then copy
+  // out the part the fine scroll selects
+  std::array<uint8_t, kScreenWidth + kTileSize> pixels;
+
+  uint8_t y = scy + line;
+  const uint8_t *map_row = &vram[map_base - 0x8000 + (y / kTileSize) * kTileMapWidth];
+  int row_offset = (y % kTileSize) * 2;
+
+  for (int tile_x = 0; tile_x <= kScreenWidth / kTileSize; tile_x++) {
+    uint8_t tile = map_row[(scx / kTileSize + tile_x) % kTileMapWidth];
+    uint16_t tile_addr = unsigned_tiles
+      ? tile * 16
+      : 0x1000 + static_cast<int8_t>(tile) * 16;
+
+    const uint8_t *tile_row = &vram[tile_addr + row_offset];
+    uint16_t colors = kSpreadBits[tile_row[0]] | (kSpreadBits[tile_row[1]] << 1);
+
+    // the high byte holds the leftmost four pixels
+    uint8_t *out = &pixels[tile_x * kTileSize];
+    std::memcpy(out, shade_quads[colors >> 8].data(), 4);
+    std::memcpy(out + 4, shade_quads[colors & 0xFF].data(), 4);
+  }
+
+  std::memcpy(row, &pixels[scx % kTileSize], kScreenWidth);
+}
+
+void PPU::reset() {
+  render = true;
+  record = false;
+  renderer.reset(framebuffer);
+  restart_source();
+  begin_source();
+  dots = 0;
+  ly = 0;
+}
+
+void PPU::begin_source() {
+  source.lines.clear();
+  source.patches.clear();
+  source.page_bytes.clear();
+  source_blank = false;
+}
+
+void PPU::restart_source() {
+  source_restart = true;
+}
+
+void PPU::step(Memory &memory, int cycles) {
+  uint8_t lcdc = memory.get8(kRegLCDC);
+  if (!(lcdc & 0x80)) {
+    dots = 0;
+    ly = 0;
+    memory.set8(kRegLY, 0);
+    memory.set8(kRegSTAT, memory.get8(kRegSTAT) & ~0x03);
+
+    // an lcd that is off shows nothing, rather than whatever was drawn last
+    if (render) {
+      renderer.blank(framebuffer);
+    }
+    if (record && !source_blank) {
+      source.lines.push_back({ pack_line_regs(lcdc, 0, 0, 0), static_cast<uint16_t>(source.patches.size()), 0 });
+      source_blank = true;
+    }
+    return;
+  }
+
+  dots += cycles;
+  while (dots >= kCyclesPerScanline) {
+    dots -= kCyclesPerScanline;
+
+    if ((render || record) && ly < kScreenHeight) {
+      uint32_t regs = pack_line_regs(memory.get8(kRegLCDC), memory.get8(kRegSCY), memory.get8(kRegSCX),
+                                     memory.get8(kRegBGP));
+      if (render) {
+        renderer.draw(framebuffer, ly, regs, &memory.ram[Memory::ram_offset(0x8000)], memory.vram_writes);
+      }
+      if (record) {
+        record_line(memory, ly, regs);
+      }
+    }
+
+    ly = (ly + 1) % kScanlinesPerFrame;
+    if (ly == kScreenHeight) {
+      memory.set8(kRegIF, memory.get8(kRegIF) | 0x01);
+    }
+  }
+
+  PPUMode mode = PPUMode::VBlank;
+  if (ly < kScreenHeight) {
+    if (dots < kOAMScanDots) {
+      mode = PPUMode::OAMScan;
+    } else if (dots < kOAMScanDots + kDrawDots) {
+      mode = PPUMode::Draw;
+    } else {
+      mode = PPUMode::HBlank;
+    }
+  }
+
+  uint8_t stat = memory.get8(kRegSTAT) & ~0x07;
+  stat |= static_cast<uint8_t>(mode);
+  if (ly == memory.get8(kRegLYC)) {
+    stat |= 0x04;
+  }
+
+  memory.set8(kRegLY, ly);
+  memory.set8(kRegSTAT, stat);
+}
+
+void PPU::save_state(StateWriter &writer) const {
+  writer.write(dots);
+  writer.write(ly);
+}
+
+bool PPU::load_state(StateReader &reader) {
+  reader.read(dots);
+  reader.read(ly);
+  return dots >= 0 && dots < kCyclesPerScanline && ly < kScanlinesPerFrame;
+}
+
+void PPU::record_line(Memory &memory, uint8_t line, uint32_t regs) {
+  source_blank = false;
+
+  if (source_restart) {
+    memory.vram_dirty = ~0u;
+    source_restart = false;
+  }
+
+  // only the pages written since the last patch are copied, usually none
+  if (memory.vram_dirty) [[unlikely]] {
+    source.patches.push_back({ memory.vram_writes, memory.vram_dirty });
+    const uint8_t *vram = &memory.ram[Memory::ram_offset(0x8000)];
+    for (uint32_t pages = memory.vram_dirty; pages; pages &= pages - 1) {
+      const uint8_t *page = &vram[std::countr_zero(pages) * kVramPageSize];
+      source.page_bytes.insert(source.page_bytes.end(), page, page + kVramPageSize);
+    }
+    memory.vram_dirty = 0;
+  }
+
+  source.lines.push_back({ regs, static_cast<uint16_t>(source.patches.size()), line });
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "memory.h"
+#include "state.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+const int kScreenWidth = 160;
+const int kScreenHeight = 144;
+const int kCyclesPerScanline = 456;
+const int kScanlinesPerFrame = 154;
+const int kCyclesPerFrame = kCyclesPerScanline * kScanlinesPerFrame;
+
+enum class PPUMode {
+  HBlank = 0,
+  VBlank = 1,
+  OAMScan = 2,
+  Draw = 3,
+};
+
+// one shade index (0-3) per pixel
+using Framebuffer = std::array<uint8_t, kScreenWidth * kScreenHeight>;
+
+const int kVramSize = 0x2000;
+const int kVramPageSize = 0x100;
+using Vram = std::array<uint8_t, kVramSize>;
+
+// a line is drawn from LCDC, SCY, SCX and BGP packed as lcdc << 24 | scy << 16 | scx << 8 | bgp
+inline uint32_t pack_line_regs(uint8_t lcdc, uint8_t scy, uint8_t scx, uint8_t bgp) {
+  return static_cast<uint32_t>(lcdc) << 24 | scy << 16 | scx << 8 | bgp;
+}
+
+// Draws background lines into a framebuffer, skipping any line whose vram and
+// registers are the same as when it was last drawn. vram_version changes
+// whenever the vram contents do.
+class LineRenderer {
+public:
+  void reset(Framebuffer &framebuffer);
+  void draw(Framebuffer &framebuffer, uint8_t line, uint32_t regs, const uint8_t *vram, uint32_t vram_version);
+
+  // clears the frame for an lcd that is off, rather than keeping whatever was drawn last
+  void blank(Framebuffer &framebuffer);
+
+private:
+  // what each line was last drawn from, vram version and registers
+  std::array<uint64_t, kScreenHeight> line_keys;
+  bool is_blank;
+
+  // shades for every group of four 2 bit colors under the current BGP
+  std::array<std::array<uint8_t, 4>, 256> shade_quads;
+  int shade_quads_bgp;
+};
+
+// What a frame was drawn from, so it can be drawn again away from the
+// emulation thread. Lines are kept in the order they were drawn, each after
+// the vram patches taken before it; a patch holds only the pages written
+// since the previous one, so most frames carry no vram at all.
+struct FrameSource {
+  struct Line {
+    uint32_t regs;
+    uint16_t patches;
+    // a line with the lcd off stands for the whole frame being blanked
+    uint8_t line;
+  };
+
+  struct VramPatch {
+    uint32_t version;
+    uint32_t pages;
+  };
+
+  std::vector<Line> lines;
+  std::vector<VramPatch> patches;
+  // the bytes of every page in each patch, lowest page first
+  std::vector<uint8_t> page_bytes;
+};
+
+class PPU {
+public:
+  void reset();
+  void step(Memory &memory, int cycles);
+
+  // starts recording a new frame into source, the first line after
+  // restart_source() patches in the whole of vram
+  void begin_source();
+  void restart_source();
+
+  void save_state(StateWriter &writer) const;
+  // false when the dot or line counter is out of range
+  bool load_state(StateReader &reader);
+
+public:
+  // when false, LY/STAT keep ticking but no pixels are produced
+  bool render;
+  Framebuffer framebuffer;
+
+  // when set, each visible line is recorded into source instead of needing render
+  bool record;
+  FrameSource source;
+
+private:
+  void record_line(Memory &memory, uint8_t line, uint32_t regs);
+
+  int dots;
+  uint8_t ly;
+
+  LineRenderer renderer;
+
+  bool source_restart;
+  bool source_blank;
+};
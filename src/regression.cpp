@@ -0,0 +1,319 @@
+#include "regression.h"
+#include "emulator.h"
+#include "hash.h"
+#include "movie.h"
+#include "png.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+namespace {
+  // no movie is written as "-" in the golden file
+  const std::string kNoMovie = "-";
+
+  // a frame's pixels depend on the rom and the movie driving it, so two cases
+  // only share goldens when both match: (rom, movie, frame)
+  using GoldenKey = std::tuple<std::string, std::string, size_t>;
+  using GoldenMap = std::map<GoldenKey, uint64_t>;
+
+  struct CaseResult {
+    bool ok = false;
+    std::vector<std::pair<size_t, uint64_t>> hashes;
+    size_t mismatches = 0;
+  };
+
+  std::mutex png_mutex;
+
+  std::optional<size_t> parse_size(std::string_view str) {
+    size_t value = 0;
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (str.empty() || ec != std::errc {} || ptr != str.data() + str.size()) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  std::optional<uint64_t> parse_hash(std::string_view str) {
+    uint64_t value = 0;
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value, 16);
+    if (str.empty() || ec != std::errc {} || ptr != str.data() + str.size()) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  GoldenKey golden_key(const RegressionCase &test, size_t frame) {
+    return { test.rom, test.movie.value_or(kNoMovie), frame };
+  }
+
+  std::string case_name(const RegressionCase &test) {
+    return test.movie.has_value() ? fmt::format("{} movie={}", test.rom, test.movie.value()) : test.rom;
+  }
+
+  // a missing file is an empty set of goldens, so --update-golden can create it
+  std::optional<GoldenMap> load_golden(const std::string &path) {
+    GoldenMap golden;
+    std::ifstream file(path);
+    std::string line;
+    for (size_t line_no = 1; std::getline(file, line); line_no++) {
+      if (line.empty()) {
+        continue;
+      }
+
+      std::istringstream fields(line);
+      std::string rom;
+      std::string movie;
+      std::string frame;
+      std::string hash;
+      std::string extra;
+      if (!(fields >> rom >> movie >> frame >> hash) || fields >> extra ||
+          !parse_size(frame).has_value() || !parse_hash(hash).has_value()) {
+        spdlog::error("{}:{}: expected <rom> <movie|-> <frame> <hash>", path, line_no);
+        return std::nullopt;
+      }
+      golden[{ rom, movie, parse_size(frame).value() }] = parse_hash(hash).value();
+    }
+    return golden;
+  }
+
+  bool save_golden(const std::string &path, const GoldenMap &golden) {
+    std::ofstream file(path);
+    if (!file) {
+      spdlog::error("Failed to write golden file: {}", path);
+      return false;
+    }
+    for (const auto &[key, hash] : golden) {
+      const auto &[rom, movie, frame] = key;
+      file << fmt::format("{} {} {} {:016x}\n", rom, movie, frame, hash);
+    }
+    return static_cast<bool>(file);
+  }
+
+  // the list index keeps names unique across roms with the same name and cases sharing a rom
+  std::string diff_name(size_t index, const RegressionCase &test, size_t frame) {
+    std::string stem = std::filesystem::path(test.rom).stem().string();
+    return fmt::format("{:03d}_{}_{:06d}.png", index, stem, frame);
+  }
+
+  CaseResult run_case(size_t index, const RegressionCase &test, const GoldenMap &golden,
+                      const RegressionOptions &options) {
+    CaseResult result;
+
+    auto rom = read_file_bytes(test.rom);
+    if (!rom.has_value()) {
+      spdlog::error("Failed to read rom: {}", test.rom);
+      return result;
+    }
+
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(rom.value());
+
+    std::optional<Movie> movie;
+    if (test.movie.has_value()) {
+      movie = load_movie(test.movie.value());
+      if (!movie.has_value()) {
+        return result;
+      }
+      if (movie->rom_hash != emulator.rom_hash() || !emulator.load_state(movie->initial_state)) {
+        spdlog::error("Movie {} does not match {}", test.movie.value(), test.rom);
+        return result;
+      }
+    }
+
+    auto checkpoint = test.checkpoints.begin();
+    for (size_t frame = 1; frame <= test.frames && checkpoint != test.checkpoints.end(); frame++) {
+      if (movie.has_value()) {
+        emulator.set_input(frame <= movie->inputs.size() ? movie->inputs[frame - 1] : 0);
+      }
+
+      // only the frames leading into a checkpoint need pixels
+      emulator.run_frame(frame + 1 >= *checkpoint);
+      if (frame != *checkpoint) {
+        continue;
+      }
+      checkpoint++;
+
+      const Framebuffer &framebuffer = emulator.framebuffer();
+      uint64_t hash = hash64(framebuffer);
+      result.hashes.emplace_back(frame, hash);
+
+      if (options.update_golden) {
+        continue;
+      }
+
+      auto expected = golden.find(golden_key(test, frame));
+      if (expected == golden.end()) {
+        spdlog::warn("{} frame {}: no golden hash", case_name(test), frame);
+        result.mismatches++;
+      } else if (expected->second != hash) {
+        spdlog::error("{} frame {}: hash {:016x} != golden {:016x}", case_name(test), frame, hash,
+                      expected->second);
+        result.mismatches++;
+
+        auto path = std::filesystem::path(options.diff_dir) / diff_name(index, test, frame);
+        std::lock_guard lock(png_mutex);
+        if (write_png(framebuffer, path.string())) {
+          spdlog::info("Wrote {}", path.string());
+        }
+      }
+    }
+
+    emulator.cleanup();
+    result.ok = true;
+    return result;
+  }
+}
+
+std::optional<std::vector<RegressionCase>> load_regression_list(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    spdlog::error("Failed to read regression list: {}", path);
+    return std::nullopt;
+  }
+
+  std::vector<RegressionCase> cases;
+  std::string line;
+  for (size_t line_no = 1; std::getline(file, line); line_no++) {
+    if (line.empty() || line.starts_with("#")) {
+      continue;
+    }
+
+    std::istringstream fields(line);
+    RegressionCase test;
+    std::string frames;
+    if (!(fields >> test.rom >> frames) || !parse_size(frames).has_value()) {
+      spdlog::error("{}:{}: expected <rom> <frames>", path, line_no);
+      return std::nullopt;
+    }
+    test.frames = parse_size(frames).value();
+    // a case with no frames would check nothing and always pass
+    if (test.frames == 0) {
+      spdlog::error("{}:{}: invalid frame count \"{}\"", path, line_no, frames);
+      return std::nullopt;
+    }
+
+    std::string field;
+    while (fields >> field) {
+      if (field.starts_with("movie=")) {
+        test.movie = field.substr(6);
+      } else if (field.starts_with("checkpoints=")) {
+        std::istringstream list(field.substr(12));
+        std::string frame;
+        while (std::getline(list, frame, ',')) {
+          auto value = parse_size(frame);
+          if (!value.has_value() || value.value() == 0) {
+            spdlog::error("{}:{}: invalid checkpoint \"{}\"", path, line_no, frame);
+            return std::nullopt;
+          }
+          test.checkpoints.push_back(value.value());
+        }
+      } else {
+        spdlog::error("{}:{}: unknown field \"{}\"", path, line_no, field);
+        return std::nullopt;
+      }
+    }
+
+    // without explicit checkpoints only the last frame is checked
+    if (test.checkpoints.empty()) {
+      test.checkpoints.push_back(test.frames);
+    }
+    std::erase_if(test.checkpoints, [&] (size_t frame) {
+      if (frame <= test.frames) {
+        return false;
+      }
+      spdlog::warn("{}:{}: checkpoint {} is past the last frame ({}), skipping it", path, line_no, frame,
+                   test.frames);
+      return true;
+    });
+    std::sort(test.checkpoints.begin(), test.checkpoints.end());
+    test.checkpoints.erase(std::unique(test.checkpoints.begin(), test.checkpoints.end()), test.checkpoints.end());
+
+    cases.push_back(std::move(test));
+  }
+
+  return cases;
+}
+
+bool run_regressions(const RegressionOptions &options) {
+  auto cases = load_regression_list(options.list_path);
+  if (!cases.has_value()) {
+    return false;
+  }
+
+  auto loaded = load_golden(options.golden_path);
+  if (!loaded.has_value()) {
+    return false;
+  }
+  GoldenMap golden = std::move(loaded.value());
+
+  if (!options.update_golden) {
+    std::error_code ec;
+    std::filesystem::create_directories(options.diff_dir, ec);
+    if (ec) {
+      spdlog::error("Failed to create {}: {}", options.diff_dir, ec.message());
+      return false;
+    }
+  }
+
+  size_t jobs = options.jobs ? options.jobs : std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+  jobs = std::min(jobs, cases->size());
+  spdlog::info("Running {} regression cases on {} threads", cases->size(), jobs);
+
+  std::vector<CaseResult> results(cases->size());
+  std::atomic<size_t> next = 0;
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < jobs; i++) {
+    workers.emplace_back([&] {
+      for (size_t idx = next++; idx < cases->size(); idx = next++) {
+        results[idx] = run_case(idx, (*cases)[idx], golden, options);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  size_t failed = 0;
+  for (size_t i = 0; i < cases->size(); i++) {
+    const RegressionCase &test = (*cases)[i];
+    const CaseResult &result = results[i];
+
+    if (!result.ok || result.mismatches > 0) {
+      failed++;
+    }
+
+    if (options.update_golden && result.ok) {
+      for (const auto &[frame, hash] : result.hashes) {
+        golden[golden_key(test, frame)] = hash;
+      }
+    }
+  }
+
+  if (options.update_golden) {
+    if (!save_golden(options.golden_path, golden)) {
+      return false;
+    }
+    spdlog::info("Updated {}", options.golden_path);
+    return failed == 0;
+  }
+
+  if (failed > 0) {
+    spdlog::error("{} of {} regression cases failed", failed, cases->size());
+    return false;
+  }
+
+  spdlog::info("All {} regression cases passed", cases->size());
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// one line of the list file:
+//   <rom> <frames> [movie=<path>] [checkpoints=<frame>,<frame>,...]
+struct RegressionCase {
+  std::string rom;
+  size_t frames;
+  std::optional<std::string> movie;
+  std::vector<size_t> checkpoints;
+};
+
+struct RegressionOptions {
+  std::string list_path;
+  std::string golden_path;
+  std::string diff_dir;
+  bool update_golden = false;
+  size_t jobs = 0;
+};
+
+std::optional<std::vector<RegressionCase>> load_regression_list(const std::string &path);
+
+// plays every case headless and checks framebuffer hashes at each checkpoint
+// against the golden file, or rewrites it when update_golden is set. Golden
+// lines are <rom> <movie or -> <frame> <hash>
+bool run_regressions(const RegressionOptions &options);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+struct StateWriter {
+  std::vector<uint8_t> &out;
+
+  void write_bytes(std::span<const uint8_t> bytes) {
+    out.insert(out.end(), bytes.begin(), bytes.end());
+  }
+
+  template <typename T>
+  void write(const T &val) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write_bytes({ reinterpret_cast<const uint8_t*>(&val), sizeof(T) });
+  }
+};
+
+struct StateReader {
+  std::span<const uint8_t> in;
+  size_t pos = 0;
+  bool ok = true;
+
+  void read_bytes(std::span<uint8_t> bytes) {
+    if (!ok || in.size() - pos < bytes.size()) {
+      ok = false;
+      return;
+    }
+    std::memcpy(bytes.data(), in.data() + pos, bytes.size());
+    pos += bytes.size();
+  }
+
+  template <typename T>
+  void read(T &val) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    read_bytes({ reinterpret_cast<uint8_t*>(&val), sizeof(T) });
+  }
+};
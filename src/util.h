@@ -1 +1,23 @@
 #pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+// visitor built from a set of lambdas, for std::visit over operand variants
+template <class... Ts>
+struct overloaded : Ts... { using Ts::operator()...; };
+
+template <class... Ts>
+overloaded(Ts...) -> overloaded<Ts...>;
+
+inline std::optional<std::vector<uint8_t>> read_file_bytes(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
@@ -0,0 +1,147 @@
+#include "batch.h"
+#include "check.h"
+#include "fixtures.h"
+#include "hash.h"
+
+namespace {
+  const uint16_t kResultAddress = 0xFF80;
+  const uint16_t kTileMapAddress = 0x9800;
+
+  // reads JOYP and stores what it saw in HRAM, then runs off into NOPs
+  std::vector<uint8_t> make_joypad_rom() {
+    return make_rom({
+      0xF0, 0x00, // LDH A, [$00]
+      0xE0, 0x80, // LDH [$80], A
+    });
+  }
+
+  // background on, with tile 0 drawn in all four shades
+  void setup_screen(Emulator &emulator) {
+    emulator.write8(0xFF40, 0x91);
+    emulator.write8(0xFF47, 0xE4);
+    for (int row = 0; row < 8; row++) {
+      emulator.write8(0x8000 + row * 2, 0x55);
+      emulator.write8(0x8000 + row * 2 + 1, 0x33);
+    }
+    emulator.write8(kTileMapAddress, 0);
+  }
+
+  EmulatorBatch make_batch(size_t instances, size_t threads, int downsample, ObservationFormat format) {
+    BatchConfig config;
+    config.instances = instances;
+    config.threads = threads;
+    config.pin_threads = false;
+    config.format = format;
+    config.downsample = downsample;
+    config.reward_addresses = { kResultAddress, kJoypadAddress };
+    return EmulatorBatch(config);
+  }
+
+  void test_observations() {
+    EmulatorBatch batch = make_batch(2, 1, 3, ObservationFormat::Grayscale);
+    batch.load_rom_bytes(make_joypad_rom());
+    for (size_t i = 0; i < batch.size(); i++) {
+      setup_screen(batch.instance(i));
+    }
+
+    std::vector<uint8_t> actions(batch.size(), 0);
+    CHECK(batch.step_frames(actions, 2));
+
+    CHECK(batch.observation_width() == kScreenWidth / 3);
+    CHECK(batch.observation_height() == kScreenHeight / 3);
+    CHECK(batch.observations().size() == batch.size() * batch.observation_size());
+
+    bool all_shades[4] = {};
+    for (size_t i = 0; i < batch.size(); i++) {
+      const Framebuffer &framebuffer = batch.instance(i).framebuffer();
+      const uint8_t *observation = &batch.observations()[i * batch.observation_size()];
+      for (int y = 0; y < batch.observation_height(); y++) {
+        for (int x = 0; x < batch.observation_width(); x++) {
+          uint8_t shade = framebuffer[y * 3 * kScreenWidth + x * 3];
+          all_shades[shade] = true;
+          CHECK(observation[y * batch.observation_width() + x] == 255 - shade * 85);
+        }
+      }
+    }
+    CHECK(all_shades[0] && all_shades[1] && all_shades[2] && all_shades[3]);
+  }
+
+  void test_rewards_and_input() {
+    EmulatorBatch batch = make_batch(4, 1, 1, ObservationFormat::Shades);
+    batch.load_rom_bytes(make_joypad_rom());
+
+    // JOYP starts with both button groups selected, so every button shows up
+    const uint8_t actions[] = {
+      0x00,
+      button_mask(Button::Right),
+      button_mask(Button::B),
+      static_cast<uint8_t>(button_mask(Button::Down) | button_mask(Button::Start)),
+    };
+    CHECK(batch.step_frames(actions, 1));
+
+    CHECK(batch.rewards().size() == batch.size() * 2);
+    for (size_t i = 0; i < batch.size(); i++) {
+      uint8_t expected = joypad_read(0x00, actions[i]);
+      CHECK(batch.rewards()[i * 2] == expected);
+      CHECK(batch.rewards()[i * 2 + 1] == expected);
+    }
+    CHECK(batch.rewards()[0] == 0xCF);
+    CHECK(batch.rewards()[2] == 0xCE);
+  }
+
+  void test_rejects_mismatched_actions() {
+    EmulatorBatch batch = make_batch(4, 1, 1, ObservationFormat::Shades);
+    batch.load_rom_bytes(make_joypad_rom());
+
+    std::vector<uint8_t> short_actions(3, button_mask(Button::A));
+    std::vector<uint8_t> long_actions(5, button_mask(Button::A));
+    CHECK(!batch.step_frames(short_actions, 1));
+    CHECK(!batch.step_frames(long_actions, 1));
+
+    // nothing ran, so the program has not stored anything yet
+    for (size_t i = 0; i < batch.size(); i++) {
+      CHECK(batch.instance(i).registers().pc == kEntryPoint);
+    }
+  }
+
+  void test_threads_match() {
+    EmulatorBatch single = make_batch(8, 1, 2, ObservationFormat::Shades);
+    EmulatorBatch multi = make_batch(8, 4, 2, ObservationFormat::Shades);
+
+    for (EmulatorBatch *batch : { &single, &multi }) {
+      batch->load_rom_bytes(make_joypad_rom());
+      for (size_t i = 0; i < batch->size(); i++) {
+        // the rom is hashed once for the batch, and every instance reports it
+        CHECK(batch->instance(i).rom_hash() == hash64(make_joypad_rom()));
+        setup_screen(batch->instance(i));
+        batch->instance(i).write8(0xFF43, i * 3);
+      }
+    }
+
+    std::vector<uint8_t> actions(single.size());
+    for (int step = 0; step < 3; step++) {
+      for (size_t i = 0; i < actions.size(); i++) {
+        actions[i] = static_cast<uint8_t>(1 << ((i + step) % 8));
+      }
+      CHECK(single.step_frames(actions, 2));
+      CHECK(multi.step_frames(actions, 2));
+
+      CHECK(std::equal(single.observations().begin(), single.observations().end(), multi.observations().begin(),
+                       multi.observations().end()));
+      CHECK(std::equal(single.rewards().begin(), single.rewards().end(), multi.rewards().begin(),
+                       multi.rewards().end()));
+    }
+
+    for (size_t i = 0; i < single.size(); i++) {
+      CHECK(single.instance(i).state_checksum() == multi.instance(i).state_checksum());
+    }
+  }
+}
+
+int main() {
+  test_observations();
+  test_rewards_and_input();
+  test_rejects_mismatched_actions();
+  test_threads_match();
+  return check_result();
+}
@@ -0,0 +1,159 @@
+#include "capture.h"
+#include "check.h"
+#include "fixtures.h"
+
+#include <filesystem>
+#include <random>
+
+namespace {
+  bool round_trip(const Framebuffer &frame, const Framebuffer &previous) {
+    std::vector<uint8_t> bytes;
+    encode_delta(frame, previous, bytes);
+
+    Framebuffer decoded = previous;
+    StateReader reader { bytes };
+    return decode_delta(reader, bytes.size(), decoded) && decoded == frame;
+  }
+
+  void test_delta_codec() {
+    std::mt19937 rng(1234);
+    Framebuffer blank {};
+    Framebuffer noise;
+    for (auto &pixel : noise) {
+      pixel = rng() & 0x03;
+    }
+
+    CHECK(round_trip(blank, blank));
+    CHECK(round_trip(noise, blank));
+    CHECK(round_trip(blank, noise));
+    CHECK(round_trip(noise, noise));
+
+    // sparse edits, including the first and last pixel and runs across words
+    Framebuffer sparse = noise;
+    sparse.front() ^= 1;
+    sparse.back() ^= 1;
+    for (int i = 0; i < 200; i++) {
+      size_t pos = rng() % sparse.size();
+      size_t len = std::min<size_t>(rng() % 20, sparse.size() - pos);
+      for (size_t j = pos; j < pos + len; j++) {
+        sparse[j] ^= 2;
+      }
+    }
+    CHECK(round_trip(sparse, noise));
+
+    // an unchanged frame costs a single empty run per 64 KiB of pixels
+    std::vector<uint8_t> bytes;
+    encode_delta(noise, noise, bytes);
+    CHECK(bytes.size() == 2 * sizeof(uint16_t));
+
+    // corrupt input is rejected, not written past the frame
+    std::vector<uint8_t> corrupt;
+    StateWriter writer { corrupt };
+    writer.write(uint16_t { kScreenWidth * kScreenHeight });
+    writer.write(uint16_t { 1 });
+    writer.write(uint8_t { 3 });
+    Framebuffer frame {};
+    StateReader reader { corrupt };
+    CHECK(!decode_delta(reader, corrupt.size(), frame));
+
+    StateReader truncated { std::span<const uint8_t>(bytes).first(3) };
+    CHECK(!decode_delta(truncated, 3, frame));
+  }
+
+  // counts the frames in a capture, checking each one is the frame that was expected
+  size_t count_frames(const std::string &path, const std::vector<Framebuffer> &expected) {
+    size_t count = 0;
+    bool ok = read_capture(path, [&] (uint32_t index, const Framebuffer &frame) {
+      if (index != count || count >= expected.size() || frame != expected[count]) {
+        return false;
+      }
+      count++;
+      return true;
+    });
+    return ok ? count : 0;
+  }
+
+  // steps a ppu through frames with random vram and register edits between its
+  // lines, pushing what each frame was drawn from and returning the frames it drew
+  std::vector<Framebuffer> push_frames(FrameCapture &capture, size_t count, std::mt19937 &rng) {
+    Memory memory;
+    memory.reset();
+    memory.set8(0xFF40, 0x91);
+    memory.set8(0xFF47, 0xE4);
+    for (int address = 0x8000; address < 0xA000; address++) {
+      memory.set8(address, rng());
+    }
+
+    PPU ppu;
+    ppu.reset();
+    ppu.record = true;
+    ppu.restart_source();
+
+    std::vector<Framebuffer> frames;
+    for (size_t i = 0; i < count; i++) {
+      ppu.begin_source();
+      for (int cycles = 0; cycles < kCyclesPerFrame; cycles += 76) {
+        ppu.step(memory, 76);
+        if (rng() % 64 != 0) {
+          continue;
+        }
+
+        uint16_t address = 0;
+        uint8_t val = rng();
+        switch (rng() % 5) {
+          case 0: address = 0x8000 + rng() % 0x2000; break;
+          case 1: address = 0xFF40; val = (rng() % 8 ? 0x80 : 0x00) | (val & 0x19); break;
+          case 2: address = 0xFF42; break;
+          case 3: address = 0xFF43; break;
+          case 4: address = 0xFF47; break;
+        }
+        memory.set8(address, val);
+      }
+
+      capture.push(ppu.source);
+      frames.push_back(ppu.framebuffer);
+    }
+    return frames;
+  }
+
+  void test_stop_drains_ring() {
+    std::string path = temp_path("aceboy_capture_test.acc");
+
+    // stopping straight after the last push still writes every frame, across a
+    // keyframe, and the writer draws the same frames the ppu did
+    for (int attempt = 0; attempt < 20; attempt++) {
+      std::mt19937 rng(attempt);
+      FrameCapture capture;
+      CHECK(capture.start(path));
+      auto frames = push_frames(capture, attempt == 0 ? 700 : attempt, rng);
+      CHECK(capture.stop());
+      CHECK(count_frames(path, frames) == frames.size());
+    }
+
+    std::filesystem::remove(path);
+  }
+
+  void test_write_failure() {
+#ifdef __linux__
+    if (!std::filesystem::exists("/dev/full")) {
+      return;
+    }
+
+    FrameCapture capture;
+    if (!capture.start("/dev/full")) {
+      return;
+    }
+    for (int i = 0; i < 100; i++) {
+      capture.push(FrameSource {});
+    }
+    CHECK(!capture.stop());
+#endif
+  }
+}
+
+int main() {
+  test_delta_codec();
+  test_stop_drains_ring();
+  test_write_failure();
+  return check_result();
+}
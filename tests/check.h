@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+
+// tests are plain executables run by ctest, a failed check is reported and
+// makes main() return non-zero without stopping the remaining checks
+inline int check_failures = 0;
+
+#define CHECK(expr)                                                             \
+  do {                                                                          \
+    if (!(expr)) {                                                              \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+      check_failures++;                                                         \
+    }                                                                           \
+  } while (0)
+
+inline int check_result() {
+  if (check_failures > 0) {
+    std::fprintf(stderr, "%d checks failed\n", check_failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,215 @@
+#include "check.h"
+#include "debugger.h"
+#include "emulator.h"
+#include "fixtures.h"
+
+namespace {
+  void test_conditions() {
+    Debugger debugger;
+    CHECK(debugger.add_breakpoint(0x0100));
+    CHECK(debugger.add_breakpoint(0x0100, "a == 0x10"));
+    CHECK(debugger.add_breakpoint(0x0100, "  HL != $C000 && zf  "));
+    CHECK(debugger.add_breakpoint(0x0100, "sp>=0xFF80&&pc<0x8000&&b<=3&&c>2"));
+    CHECK(debugger.add_breakpoint(0x0100, "cf"));
+
+    CHECK(!debugger.add_breakpoint(0x0100, "x == 1"));
+    CHECK(!debugger.add_breakpoint(0x0100, "a =="));
+    CHECK(!debugger.add_breakpoint(0x0100, "a == 0x"));
+    CHECK(!debugger.add_breakpoint(0x0100, "a == 0x10000"));
+    CHECK(!debugger.add_breakpoint(0x0100, "a = 1"));
+    CHECK(!debugger.add_breakpoint(0x0100, "a == 1 &&"));
+    CHECK(!debugger.add_breakpoint(0x0100, "a == 1 b == 2"));
+    CHECK(debugger.breakpoints().size() == 5);
+
+    Registers regs {};
+    regs.reset();
+    regs.pc = 0x0200;
+    regs.set(Reg8::A, 0x10);
+    regs.set(Reg16::HL, 0xC000);
+
+    Debugger conditional;
+    conditional.add_breakpoint(0x0200, "a == 0x10 && hl == 0xC000 && !zf");
+    CHECK(conditional.breakpoints().empty());
+
+    conditional.add_breakpoint(0x0200, "a == 0x10 && hl == 0xc000");
+    CHECK(conditional.check_breakpoint(regs));
+    CHECK(conditional.triggered());
+
+    conditional.resume(regs.pc);
+    regs.set(Reg8::A, 0x11);
+    regs.pc = 0x0201;
+    CHECK(!conditional.check_breakpoint(regs));
+    regs.pc = 0x0200;
+    CHECK(!conditional.check_breakpoint(regs));
+  }
+
+  void test_watchpoints() {
+    struct Case {
+      std::initializer_list<uint8_t> program;
+      uint16_t address;
+      WatchKind kind;
+    };
+    const Case cases[] = {
+      { { 0xEA, 0x00, 0xC0 }, 0xC000, WatchKind::Write },  // LD [a16], A
+      { { 0xFA, 0x34, 0xC1 }, 0xC134, WatchKind::Read },   // LD A, [a16]
+      { { 0xE0, 0x80 }, 0xFF80, WatchKind::Write },        // LDH [a8], A
+      { { 0xF2 }, 0xFF00, WatchKind::Read },               // LD A, [C]
+      { { 0x77 }, 0x0000, WatchKind::Write },              // LD [HL], A
+      { { 0x34 }, 0x0000, WatchKind::Read },               // INC [HL] reads before writing
+      { { 0xCB, 0xC6 }, 0x0000, WatchKind::Write },        // SET 0, [HL] writes its source
+      { { 0xCB, 0x86 }, 0x0000, WatchKind::Read },         // RES 0, [HL] reads it first
+    };
+
+    for (const auto &test : cases) {
+      Emulator emulator;
+      emulator.initialize();
+      emulator.load_rom_bytes(make_rom(test.program));
+      emulator.debugger().add_watchpoint(test.address, test.address, test.kind);
+
+      emulator.run_frame(false);
+      CHECK(emulator.debugger().triggered());
+      CHECK(emulator.registers().pc == kEntryPoint + test.program.size());
+    }
+
+    // a watchpoint elsewhere stays quiet
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom({ 0xEA, 0x00, 0xC0 }));
+    emulator.debugger().add_watchpoint(0xC001, 0xC0FF, WatchKind::ReadWrite);
+    emulator.run_frame(false);
+    CHECK(!emulator.debugger().triggered());
+
+    // jump and call targets are not accessed
+    const Case branches[] = {
+      { { 0xC3, 0x00, 0xC0 }, 0xC000, WatchKind::ReadWrite },  // JP $C000
+      { { 0xCD, 0x80, 0xFF }, 0xFF80, WatchKind::ReadWrite },  // CALL $FF80
+    };
+    for (const auto &test : branches) {
+      Emulator branch;
+      branch.initialize();
+      branch.load_rom_bytes(make_rom(test.program));
+      branch.debugger().add_watchpoint(test.address, test.address, test.kind);
+      branch.run_frame(false);
+      CHECK(!branch.debugger().triggered());
+    }
+
+    // as does a read watchpoint on a plain store
+    emulator.reset();
+    emulator.debugger().remove_watchpoint(0);
+    emulator.debugger().add_watchpoint(0xC000, 0xC000, WatchKind::Read);
+    emulator.run_frame(false);
+    CHECK(!emulator.debugger().triggered());
+
+    emulator.write8(0xC000, 1);
+    CHECK(!emulator.debugger().triggered());
+    emulator.debugger().add_watchpoint(0xC000, 0xC000, WatchKind::Write);
+    emulator.write8(0xC000, 1);
+    CHECK(emulator.debugger().triggered());
+  }
+
+  void test_copied_emulator() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom({ 0xEA, 0x00, 0xC0 }));  // LD [$C000], A
+    emulator.debugger().add_watchpoint(0xC000, 0xC000, WatchKind::Write);
+
+    // a copy stops on its own debugger and leaves the original's alone
+    Emulator copy = emulator;
+    copy.run_frame(false);
+    CHECK(copy.debugger().triggered());
+    CHECK(!emulator.debugger().triggered());
+
+    emulator.run_frame(false);
+    CHECK(emulator.debugger().triggered());
+  }
+
+  void test_resume_records_whole_frames() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom());
+
+    // a breakpoint part way through the first frame
+    emulator.start_recording(1);
+    emulator.debugger().add_breakpoint(0x2000);
+    emulator.play();
+    emulator.run_frame(false);
+    CHECK(emulator.debugger().triggered());
+    CHECK(emulator.registers().pc == 0x2000);
+
+    emulator.run_frame(false);
+    CHECK(emulator.registers().pc == 0x2000);
+
+    emulator.debugger().remove_breakpoint(0);
+    emulator.play();
+    for (int frame = 0; frame < 4; frame++) {
+      emulator.run_frame(false);
+    }
+
+    auto movie = emulator.stop_recording();
+    CHECK(movie.has_value() && movie->inputs.size() == 4);
+    if (movie.has_value()) {
+      auto result = replay_movie(emulator, movie.value());
+      CHECK(result.has_value() && result->frames == 4 && !result->desync_frame.has_value());
+    }
+  }
+
+  void test_stale_resume() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom());
+
+    // playing with nothing to resume from must not skip a later breakpoint
+    emulator.play();
+    emulator.debugger().add_breakpoint(kEntryPoint);
+    emulator.run_frame(false);
+    CHECK(emulator.debugger().triggered());
+    CHECK(emulator.registers().pc == kEntryPoint);
+
+    // resuming from the hit steps over it once
+    emulator.play();
+    emulator.run_frame(false);
+    CHECK(!emulator.debugger().triggered());
+  }
+
+  void test_resume_from_watchpoint() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom({ 0xEA, 0x00, 0xC0 }));  // LD [$C000], A
+
+    // a watchpoint stops on the next instruction, which has not hit its breakpoint yet
+    emulator.debugger().add_watchpoint(0xC000, 0xC000, WatchKind::Write);
+    emulator.debugger().add_breakpoint(kEntryPoint + 3);
+    emulator.play();
+    emulator.run_frame(false);
+    CHECK(emulator.debugger().triggered());
+    CHECK(emulator.registers().pc == kEntryPoint + 3);
+
+    emulator.play();
+    emulator.run_frame(false);
+    CHECK(emulator.debugger().triggered());
+    CHECK(emulator.registers().pc == kEntryPoint + 3);
+
+    // the same goes for a write from the memory panel
+    emulator.play();
+    emulator.run_frame(false);
+    emulator.reset();
+    emulator.debugger().remove_breakpoint(0);
+    emulator.debugger().add_breakpoint(kEntryPoint);
+    emulator.write8(0xC000, 1);
+    CHECK(emulator.debugger().triggered());
+    emulator.play();
+    emulator.run_frame(false);
+    CHECK(emulator.debugger().triggered());
+    CHECK(emulator.registers().pc == kEntryPoint);
+  }
+}
+
+int main() {
+  test_conditions();
+  test_watchpoints();
+  test_copied_emulator();
+  test_resume_records_whole_frames();
+  test_stale_resume();
+  test_resume_from_watchpoint();
+  return check_result();
+}
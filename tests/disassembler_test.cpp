@@ -0,0 +1,66 @@
+#include "check.h"
+#include "disassembler.h"
+
+namespace {
+  const uint16_t kBase = 0xC000;
+
+  void test_range() {
+    Memory memory;
+    memory.reset();
+
+    // LD A, $10; NOP; LD [$C123], A
+    const uint8_t program[] = { 0x3E, 0x10, 0x00, 0xEA, 0x23, 0xC1 };
+    for (size_t i = 0; i < std::size(program); i++) {
+      memory.set8(kBase + i, program[i]);
+    }
+
+    Disassembler disassembler;
+    auto lines = disassembler.disassemble(memory, kBase, 4);
+    CHECK(lines.size() == 4);
+    if (lines.size() == 4) {
+      CHECK(lines[0].address == kBase && lines[0].length == 2 && lines[0].text == "LD A, $10");
+      CHECK(lines[1].address == kBase + 2 && lines[1].length == 1 && lines[1].text == "NOP");
+      CHECK(lines[2].address == kBase + 3 && lines[2].length == 3 && lines[2].text == "LD [$C123], A");
+      CHECK(lines[3].address == kBase + 6 && lines[3].text == "NOP");
+    }
+
+    // the same range again comes straight from the cache
+    CHECK(disassembler.disassemble(memory, kBase, 4)[2].text == "LD [$C123], A");
+
+    // a write inside the cached page decodes it again
+    memory.set8(kBase + 1, 0x20);
+    lines = disassembler.disassemble(memory, kBase, 4);
+    CHECK(lines[0].text == "LD A, $20");
+    CHECK(lines[2].text == "LD [$C123], A");
+
+    memory.set8(kBase + 2, 0xEA);
+    lines = disassembler.disassemble(memory, kBase, 2);
+    CHECK(lines[1].address == kBase + 2 && lines[1].length == 3 && lines[1].text == "LD [$23EA], A");
+  }
+
+  void test_instruction_across_pages() {
+    Memory memory;
+    memory.reset();
+
+    // LD [$1234], A with its operand in the first two bytes of the next page
+    const uint16_t address = kBase + 0xFF;
+    memory.set8(address, 0xEA);
+    memory.set8(address + 1, 0x34);
+    memory.set8(address + 2, 0x12);
+
+    Disassembler disassembler;
+    CHECK(disassembler.disassemble(memory, address, 1)[0].text == "LD [$1234], A");
+
+    memory.set8(address + 1, 0x78);
+    CHECK(disassembler.disassemble(memory, address, 1)[0].text == "LD [$1278], A");
+
+    memory.set8(address + 2, 0x56);
+    CHECK(disassembler.disassemble(memory, address, 1)[0].text == "LD [$5678], A");
+  }
+}
+
+int main() {
+  test_range();
+  test_instruction_across_pages();
+  return check_result();
+}
@@ -0,0 +1,128 @@
+#include "check.h"
+#include "emulator.h"
+#include "fixtures.h"
+
+#include <limits>
+
+namespace {
+  void setup(Emulator &emulator) {
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom());
+    emulator.play();
+  }
+
+  void test_normal_speed() {
+    Emulator emulator;
+    setup(emulator);
+
+    for (int i = 0; i < 3; i++) {
+      emulator.update();
+      CHECK(emulator.stats().frames == 1);
+      CHECK(emulator.stats().rendered == 1);
+    }
+
+    // a stopped emulator does no work at all
+    emulator.stop();
+    emulator.update();
+    CHECK(emulator.stats().frames == 0);
+    CHECK(emulator.stats().rendered == 0);
+  }
+
+  void test_fractional_speed() {
+    Emulator emulator;
+    setup(emulator);
+    CHECK(emulator.set_speed(2.5f));
+    emulator.set_fast_forward(true);
+
+    // the half frame carries over, and only the last frame of each batch is drawn
+    const int expected[] = { 2, 3, 2, 3, 2, 3 };
+    for (int frames : expected) {
+      emulator.update();
+      CHECK(emulator.stats().frames == frames);
+      CHECK(emulator.stats().rendered == 1);
+    }
+
+    // toggling fast forward drops the carried fraction
+    emulator.update();
+    CHECK(emulator.stats().frames == 2);
+    emulator.toggle_fast_forward();
+    emulator.toggle_fast_forward();
+    emulator.update();
+    CHECK(emulator.stats().frames == 2);
+
+    // below one frame per update, updates with no frame draw nothing
+    CHECK(emulator.set_speed(0.5f));
+    emulator.set_fast_forward(true);
+    emulator.update();
+    CHECK(emulator.stats().frames == 0);
+    CHECK(emulator.stats().rendered == 0);
+    emulator.update();
+    CHECK(emulator.stats().frames == 1);
+    CHECK(emulator.stats().rendered == 1);
+  }
+
+  void test_unlimited_speed() {
+    Emulator emulator;
+    setup(emulator);
+    CHECK(emulator.set_speed(kSpeedUnlimited));
+    emulator.set_fast_forward(true);
+
+    emulator.update();
+    CHECK(emulator.stats().frames >= 1);
+    CHECK(emulator.stats().rendered == 1);
+  }
+
+  void test_breakpoint_ends_batch() {
+    // a breakpoint part way through the first frame stops the batch there
+    for (float speed : { kSpeedUnlimited, kDefaultFastForwardSpeed }) {
+      Emulator emulator;
+      setup(emulator);
+      CHECK(emulator.set_speed(speed));
+      emulator.set_fast_forward(true);
+      emulator.debugger().add_breakpoint(0x2000);
+
+      emulator.update();
+      CHECK(emulator.debugger().triggered());
+      CHECK(!emulator.is_playing());
+      CHECK(emulator.stats().frames == 1);
+      CHECK(emulator.stats().rendered == 0);
+
+      emulator.update();
+      CHECK(emulator.stats().frames == 0);
+    }
+  }
+
+  void test_speed_limits() {
+    Emulator emulator;
+    setup(emulator);
+    CHECK(emulator.speed() == kDefaultFastForwardSpeed);
+
+    // non-finite speeds are rejected and leave the speed as it was
+    CHECK(emulator.set_speed(3.0f));
+    CHECK(!emulator.set_speed(std::numeric_limits<float>::quiet_NaN()));
+    CHECK(!emulator.set_speed(std::numeric_limits<float>::infinity()));
+    CHECK(!emulator.set_speed(-std::numeric_limits<float>::infinity()));
+    CHECK(emulator.speed() == 3.0f);
+
+    // anything else is clamped into range
+    CHECK(emulator.set_speed(1000.0f));
+    CHECK(emulator.speed() == kMaxSpeedMultiplier);
+    CHECK(emulator.set_speed(-2.0f));
+    CHECK(emulator.speed() == kSpeedUnlimited);
+
+    CHECK(emulator.set_speed(1000.0f));
+    emulator.set_fast_forward(true);
+    emulator.update();
+    CHECK(emulator.stats().frames == static_cast<int>(kMaxSpeedMultiplier));
+    CHECK(emulator.stats().rendered == 1);
+  }
+}
+
+int main() {
+  test_normal_speed();
+  test_fractional_speed();
+  test_unlimited_speed();
+  test_breakpoint_ends_batch();
+  test_speed_limits();
+  return check_result();
+}
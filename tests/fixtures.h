@@ -0,0 +1,24 @@
+#pragma once
+
+#include "memory.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// fixtures shared by the tests that run code on an emulator or write files
+const uint16_t kEntryPoint = 0x0100;
+
+// a two bank rom of NOPs with the given bytes placed at the entry point
+inline std::vector<uint8_t> make_rom(std::initializer_list<uint8_t> program = {}) {
+  std::vector<uint8_t> rom(2 * kRomBankSize, 0x00);
+  std::copy(program.begin(), program.end(), rom.begin() + kEntryPoint);
+  return rom;
+}
+
+inline std::string temp_path(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
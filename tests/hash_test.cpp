@@ -0,0 +1,22 @@
+#include "check.h"
+#include "hash.h"
+
+#include <string_view>
+
+namespace {
+  uint64_t hash_string(std::string_view str, uint64_t seed = 0) {
+    return hash64({ reinterpret_cast<const uint8_t*>(str.data()), str.size() }, seed);
+  }
+}
+
+int main() {
+  // reference XXH64 values, covering the tail-only path and the 32 byte stripes
+  CHECK(hash_string("") == 0xef46db3751d8e999ull);
+  CHECK(hash_string("a") == 0xd24ec4f1a98c6e5bull);
+  CHECK(hash_string("abc") == 0x44bc2cf5ad770999ull);
+  CHECK(hash_string("Nobody inspects the spammish repetition") == 0xfbcea83c8a378bf1ull);
+  CHECK(hash_string("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0") == 0x833cd5aa4efe57a5ull);
+  CHECK(hash_string("abc", 1234) == 0x2151859f42f363e2ull);
+
+  return check_result();
+}
@@ -0,0 +1,120 @@
+#include "check.h"
+#include "memory.h"
+
+#include <set>
+
+namespace {
+  Memory make_memory() {
+    Memory memory;
+    memory.reset();
+
+    // every byte of each rom bank holds its bank number
+    auto rom = std::make_shared<Rom>(4 * kRomBankSize);
+    for (size_t i = 0; i < rom->size(); i++) {
+      (*rom)[i] = i / kRomBankSize;
+    }
+    memory.rom = rom;
+    return memory;
+  }
+
+  void test_layout() {
+    // every address outside rom and echo ram gets its own byte
+    std::set<size_t> offsets;
+    for (uint32_t address = kRomEnd; address < kMemoryMaxSize; address++) {
+      size_t offset = Memory::ram_offset(address);
+      CHECK(offset < kRamSize);
+      if (address < kEchoStart || address >= kEchoEnd) {
+        CHECK(offsets.insert(offset).second);
+      }
+    }
+    CHECK(offsets.size() == kRamSize);
+
+    // 0xFE00-0xFFFF comes straight after 0x8000-0xDFFF
+    CHECK(Memory::ram_offset(0xDFFF) == kEchoStart - kRomEnd - 1);
+    CHECK(Memory::ram_offset(0xFE00) == kEchoStart - kRomEnd);
+    CHECK(Memory::ram_offset(0xFFFF) == kRamSize - 1);
+  }
+
+  void test_echo_ram() {
+    Memory memory = make_memory();
+    for (uint32_t address = kEchoStart; address < kEchoEnd; address++) {
+      CHECK(Memory::ram_offset(address) == Memory::ram_offset(address - 0x2000));
+    }
+
+    memory.set8(0xC123, 0x42);
+    CHECK(memory.get8(0xE123) == 0x42);
+    memory.set8(0xFDFF, 0x24);
+    CHECK(memory.get8(0xDDFF) == 0x24);
+
+    // oam right after echo ram is its own memory
+    memory.set8(0xFE00, 0x99);
+    CHECK(memory.get8(0xDE00) == 0x00);
+    CHECK(memory.get8(0xFE00) == 0x99);
+  }
+
+  void test_rom() {
+    Memory memory = make_memory();
+    CHECK(memory.get8(0x0000) == 0);
+    CHECK(memory.get8(0x3FFF) == 0);
+    CHECK(memory.get8(0x4000) == 1);
+
+    memory.rom_bank = 3;
+    CHECK(memory.get8(0x4000) == 3);
+    CHECK(memory.get8(0x7FFF) == 3);
+    CHECK(memory.get8(0x0000) == 0);
+
+    // past the end of the cartridge reads open bus
+    memory.rom_bank = 4;
+    CHECK(memory.get8(0x4000) == 0xff);
+
+    // writes are dropped, through set8 and through a reference alike
+    memory.rom_bank = 1;
+    memory.set8(0x4000, 0x77);
+    memory.at(0x4000, true) = 0x77;
+    CHECK(memory.get8(0x4000) == 1);
+    CHECK(memory.rom->at(kRomBankSize) == 1);
+
+    Memory empty;
+    empty.reset();
+    CHECK(empty.get8(0x0100) == 0xff);
+  }
+
+  void test_joypad() {
+    Memory memory = make_memory();
+    memory.joypad = button_mask(Button::A) | button_mask(Button::Left);
+
+    // select the action buttons only, then read through both paths
+    memory.at(kJoypadAddress, true) = 0x10;
+    CHECK(memory.get8(kJoypadAddress) == 0xDE);
+    CHECK(memory.at(kJoypadAddress, false) == 0xDE);
+
+    // a read through the reference leaves the select bits alone
+    memory.at(kJoypadAddress, false) = 0x00;
+    CHECK(memory.ram[Memory::ram_offset(kJoypadAddress)] == 0x10);
+  }
+
+  void test_vram_writes() {
+    Memory memory = make_memory();
+    uint32_t writes = memory.vram_writes;
+
+    // only writes into vram count, whichever path they take
+    memory.set8(0x8000, 1);
+    memory.at(0x9FFF, true) = 1;
+    CHECK(memory.vram_writes == writes + 2);
+
+    memory.at(0x8000, false);
+    memory.set8(0xA000, 1);
+    memory.set8(0x7FFF, 1);
+    CHECK(memory.get8(0x8000) == 1);
+    CHECK(memory.vram_writes == writes + 2);
+  }
+}
+
+int main() {
+  test_layout();
+  test_echo_ram();
+  test_rom();
+  test_joypad();
+  test_vram_writes();
+  return check_result();
+}
@@ -0,0 +1,217 @@
+#include "check.h"
+#include "emulator.h"
+#include "fixtures.h"
+#include "movie.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace {
+  void test_round_trip() {
+    Movie movie;
+    movie.rom_hash = 0x0123456789abcdefull;
+    movie.initial_state = { 1, 2, 3, 4, 5 };
+    movie.checksum_interval = 60;
+    movie.checksums = { 11, 22, 33 };
+    movie.final_checksum = 44;
+
+    // short runs, a single frame and a run longer than one RLE entry can hold
+    movie.inputs.insert(movie.inputs.end(), 3, 0x01);
+    movie.inputs.push_back(0x80);
+    movie.inputs.insert(movie.inputs.end(), std::numeric_limits<uint16_t>::max() + 10, 0x00);
+    movie.inputs.push_back(0x11);
+
+    std::string path = temp_path("aceboy_movie_test.acm");
+    CHECK(save_movie(movie, path));
+
+    auto loaded = load_movie(path);
+    CHECK(loaded.has_value());
+    if (loaded.has_value()) {
+      CHECK(loaded->rom_hash == movie.rom_hash);
+      CHECK(loaded->initial_state == movie.initial_state);
+      CHECK(loaded->inputs == movie.inputs);
+      CHECK(loaded->checksum_interval == movie.checksum_interval);
+      CHECK(loaded->checksums == movie.checksums);
+      CHECK(loaded->final_checksum == movie.final_checksum);
+    }
+
+    // a truncated file is rejected rather than replayed short
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+    CHECK(!load_movie(path).has_value());
+
+    std::filesystem::remove(path);
+    CHECK(!load_movie(path).has_value());
+  }
+
+  void test_run_past_frames() {
+    Movie movie;
+    movie.initial_state = { 1, 2, 3 };
+    movie.inputs.insert(movie.inputs.end(), std::numeric_limits<uint16_t>::max(), 0x01);
+
+    std::string path = temp_path("aceboy_movie_test.acm");
+    CHECK(save_movie(movie, path));
+    CHECK(load_movie(path).has_value());
+
+    // the frame count follows the magic, version, rom hash and sized initial state
+    std::vector<uint8_t> bytes;
+    {
+      std::ifstream file(path, std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    size_t frames_pos = 4 + 4 + 8 + 4 + movie.initial_state.size();
+    uint32_t frames = 1;
+    std::memcpy(&bytes[frames_pos], &frames, sizeof(frames));
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+    // a run longer than the frames left is rejected
+    CHECK(!load_movie(path).has_value());
+    std::filesystem::remove(path);
+  }
+
+  void test_record_replay() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom());
+
+    // 130 frames leaves a tail past the last interval checksum
+    emulator.start_recording(60);
+    for (int frame = 0; frame < 130; frame++) {
+      emulator.set_input(frame % 7 == 0 ? 0x01 : 0x00);
+      emulator.run_frame(false);
+    }
+    auto movie = emulator.stop_recording();
+    CHECK(movie.has_value());
+    if (!movie.has_value()) {
+      return;
+    }
+    CHECK(movie->inputs.size() == 130);
+    CHECK(movie->checksums.size() == 2);
+
+    auto result = replay_movie(emulator, movie.value());
+    CHECK(result.has_value() && result->frames == 130 && !result->desync_frame.has_value());
+
+    movie->final_checksum ^= 1;
+    result = replay_movie(emulator, movie.value());
+    CHECK(result.has_value() && result->desync_frame == 130);
+
+    emulator.cleanup();
+  }
+
+  void test_bad_state_keeps_machine() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom());
+    emulator.write8(0xC000, 0x42);
+    for (int frame = 0; frame < 3; frame++) {
+      emulator.run_frame(false);
+    }
+    auto before = emulator.save_state();
+
+    // both a truncated state and one with trailing bytes are only caught part
+    // way through, after some of it would already have been read
+    std::vector<uint8_t> truncated(before.begin(), before.end() - 1);
+    std::vector<uint8_t> extended = before;
+    extended.push_back(0);
+    for (auto &bytes : { truncated, extended }) {
+      std::vector<uint8_t> other = bytes;
+      std::fill(other.begin(), other.begin() + std::min<size_t>(other.size(), 64), 0xAA);
+      CHECK(!emulator.load_state(other));
+      CHECK(emulator.save_state() == before);
+      CHECK(emulator.read8(0xC000) == 0x42);
+    }
+
+    CHECK(!emulator.load_state({}));
+    CHECK(emulator.save_state() == before);
+
+    // a state of the right size can still hold values the machine never reaches,
+    // it ends with the ppu dots and line followed by the cycle debt
+    const size_t halt = sizeof(Registers::vals) + 2 * sizeof(uint16_t) + offsetof(State, halt);
+    const size_t cycle_debt = before.size() - sizeof(int);
+    const size_t ly = cycle_debt - sizeof(uint8_t);
+    const size_t dots = ly - sizeof(int);
+    const std::pair<size_t, int> out_of_range[] = {
+      { halt, 0xAA },
+      { ly, kScanlinesPerFrame },
+      { dots, kCyclesPerScanline },
+      { dots, -1 },
+      { dots, std::numeric_limits<int>::max() },
+      { cycle_debt, kCyclesPerFrame + 1 },
+      { cycle_debt, std::numeric_limits<int>::min() },
+    };
+    for (const auto &[offset, value] : out_of_range) {
+      std::vector<uint8_t> bad = before;
+      if (offset == halt || offset == ly) {
+        bad[offset] = static_cast<uint8_t>(value);
+      } else {
+        std::memcpy(&bad[offset], &value, sizeof(int));
+      }
+      CHECK(!emulator.load_state(bad));
+      CHECK(emulator.save_state() == before);
+    }
+
+    // the edges of each range still load
+    std::vector<uint8_t> edge = before;
+    edge[ly] = kScanlinesPerFrame - 1;
+    int last_dot = kCyclesPerScanline - 1;
+    std::memcpy(&edge[dots], &last_dot, sizeof(int));
+    CHECK(emulator.load_state(edge));
+    CHECK(emulator.load_state(before));
+  }
+
+  void test_step_records_whole_frames() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom());
+
+    // NOPs take 4 cycles, so this steps through one frame and into the next
+    emulator.start_recording(1);
+    for (int i = 0; i < kCyclesPerFrame / 4 + 100; i++) {
+      emulator.step();
+    }
+    emulator.run_frame(false);
+    emulator.run_frame(false);
+
+    auto movie = emulator.stop_recording();
+    CHECK(movie.has_value() && movie->inputs.size() == 3);
+    if (movie.has_value()) {
+      auto result = replay_movie(emulator, movie.value());
+      CHECK(result.has_value() && result->frames == 3 && !result->desync_frame.has_value());
+    }
+  }
+
+  void test_reset_restarts_recording() {
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(make_rom());
+
+    emulator.start_recording(1);
+    for (int frame = 0; frame < 20; frame++) {
+      if (frame == 12) {
+        emulator.reset();
+      }
+      emulator.run_frame(false);
+    }
+
+    // only the frames after the reset can be replayed from one starting state
+    auto movie = emulator.stop_recording();
+    CHECK(movie.has_value() && movie->inputs.size() == 8);
+    if (movie.has_value()) {
+      auto result = replay_movie(emulator, movie.value());
+      CHECK(result.has_value() && result->frames == 8 && !result->desync_frame.has_value());
+    }
+  }
+}
+
+int main() {
+  test_round_trip();
+  test_run_past_frames();
+  test_record_replay();
+  test_bad_state_keeps_machine();
+  test_step_records_whole_frames();
+  test_reset_restarts_recording();
+  return check_result();
+}
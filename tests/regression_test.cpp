@@ -0,0 +1,178 @@
+#include "check.h"
+#include "emulator.h"
+#include "fixtures.h"
+#include "hash.h"
+#include "movie.h"
+#include "regression.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+namespace {
+  void write_text(const std::string &path, const std::string &text) {
+    std::ofstream file(path);
+    file << text;
+  }
+
+  std::string read_text(const std::string &path) {
+    std::ifstream file(path);
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+  }
+
+  std::optional<std::vector<RegressionCase>> parse_list(const std::string &text) {
+    std::string path = temp_path("aceboy_regression_test.txt");
+    write_text(path, text);
+    return load_regression_list(path);
+  }
+
+  void test_list() {
+    // comments and blank lines are skipped, the last frame is checked by default
+    auto cases = parse_list("# roms\n\ngame.gb 30\n");
+    CHECK(cases.has_value() && cases->size() == 1);
+    if (cases.has_value() && cases->size() == 1) {
+      CHECK(cases->front().rom == "game.gb");
+      CHECK(cases->front().frames == 30);
+      CHECK(!cases->front().movie.has_value());
+      CHECK(cases->front().checkpoints == std::vector<size_t> { 30 });
+    }
+
+    // checkpoints are sorted and deduplicated, ones past the end are dropped
+    cases = parse_list("game.gb 30 movie=run.acm checkpoints=40,10,30,10\n");
+    CHECK(cases.has_value() && cases->size() == 1);
+    if (cases.has_value() && cases->size() == 1) {
+      CHECK(cases->front().movie == "run.acm");
+      CHECK(cases->front().checkpoints == (std::vector<size_t> { 10, 30 }));
+    }
+
+    CHECK(!parse_list("game.gb\n").has_value());
+    CHECK(!parse_list("game.gb 3x\n").has_value());
+    CHECK(!parse_list("game.gb 0\n").has_value());
+    CHECK(!parse_list("game.gb 0 checkpoints=1\n").has_value());
+    CHECK(!parse_list("game.gb 30 speed=2\n").has_value());
+    CHECK(!parse_list("game.gb 30 checkpoints=0\n").has_value());
+    CHECK(!parse_list("game.gb 30 checkpoints=5,,10\n").has_value());
+  }
+
+  void test_golden() {
+    std::string rom_path = temp_path("aceboy_regression_test.gb");
+    std::vector<uint8_t> rom = make_rom();
+    std::ofstream(rom_path, std::ios::binary).write(reinterpret_cast<const char*>(rom.data()), rom.size());
+
+    // the movie starts with the lcd on and a striped tile, so its frames differ
+    // from the plain case on the same rom
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(rom);
+    emulator.write8(0xFF40, 0x91);
+    emulator.write8(0xFF47, 0xE4);
+    emulator.write8(0x8000, 0xFF);
+    emulator.start_recording(kDefaultChecksumInterval);
+    for (int frame = 0; frame < 5; frame++) {
+      emulator.run_frame(false);
+    }
+    std::string movie_path = temp_path("aceboy_regression_test.acm");
+    CHECK(save_movie(emulator.stop_recording().value(), movie_path));
+
+    RegressionOptions options;
+    options.list_path = temp_path("aceboy_regression_test.txt");
+    options.golden_path = temp_path("aceboy_regression_test.golden");
+    options.diff_dir = temp_path("aceboy_regression_test_diff");
+    options.jobs = 2;
+    std::filesystem::remove(options.golden_path);
+    std::filesystem::remove_all(options.diff_dir);
+    write_text(options.list_path, rom_path + " 5\n" + rom_path + " 5 movie=" + movie_path + "\n");
+
+    // both cases keep their own hash although they share a rom and a frame
+    options.update_golden = true;
+    CHECK(run_regressions(options));
+    std::string golden = read_text(options.golden_path);
+    CHECK(std::count(golden.begin(), golden.end(), '\n') == 2);
+    CHECK(golden.find(rom_path + " - 5 ") != std::string::npos);
+    CHECK(golden.find(rom_path + " " + movie_path + " 5 ") != std::string::npos);
+
+    options.update_golden = false;
+    CHECK(run_regressions(options));
+
+    // a changed hash fails and writes that case's frame under its list index
+    std::string changed = golden;
+    size_t digit = changed.find(movie_path + " 5 ") + movie_path.size() + 3;
+    changed[digit] = changed[digit] == '0' ? '1' : '0';
+    write_text(options.golden_path, changed);
+    CHECK(!run_regressions(options));
+    CHECK(std::filesystem::exists(std::filesystem::path(options.diff_dir) / "001_aceboy_regression_test_000005.png"));
+    CHECK(!std::filesystem::exists(std::filesystem::path(options.diff_dir) / "000_aceboy_regression_test_000005.png"));
+
+    // a malformed golden line stops the run before any case
+    write_text(options.golden_path, golden + "broken line\n");
+    CHECK(!run_regressions(options));
+
+    // so does a diff directory that cannot be created
+    write_text(options.golden_path, golden);
+    options.diff_dir = options.golden_path + "/diff";
+    CHECK(!run_regressions(options));
+  }
+
+  void test_lcd_off() {
+    std::string rom_path = temp_path("aceboy_regression_test_lcd.gb");
+    std::vector<uint8_t> rom = make_rom();
+    std::ofstream(rom_path, std::ios::binary).write(reinterpret_cast<const char*>(rom.data()), rom.size());
+
+    // a first segment draws the striped tile, then the lcd is switched off
+    // between frames and a second segment is recorded from there
+    Emulator emulator;
+    emulator.initialize();
+    emulator.load_rom_bytes(rom);
+    emulator.write8(0xFF40, 0x91);
+    emulator.write8(0xFF47, 0xE4);
+    emulator.write8(0x8000, 0xFF);
+    emulator.start_recording(kDefaultChecksumInterval);
+    for (int frame = 0; frame < 5; frame++) {
+      emulator.run_frame(true);
+    }
+    std::string on_path = temp_path("aceboy_regression_test_lcd_on.acm");
+    CHECK(save_movie(emulator.stop_recording().value(), on_path));
+    const uint64_t blank = hash64(Framebuffer {});
+    CHECK(hash64(emulator.framebuffer()) != blank);
+
+    emulator.write8(0xFF40, 0x11);
+    emulator.start_recording(kDefaultChecksumInterval);
+    for (int frame = 0; frame < 5; frame++) {
+      emulator.run_frame(true);
+    }
+    std::string off_path = temp_path("aceboy_regression_test_lcd_off.acm");
+    CHECK(save_movie(emulator.stop_recording().value(), off_path));
+
+    // the stripes drawn before do not survive into the lcd off frames
+    CHECK(hash64(emulator.framebuffer()) == blank);
+
+    RegressionOptions options;
+    options.list_path = temp_path("aceboy_regression_test_lcd.txt");
+    options.golden_path = temp_path("aceboy_regression_test_lcd.golden");
+    options.diff_dir = temp_path("aceboy_regression_test_lcd_diff");
+    options.jobs = 1;
+    std::filesystem::remove(options.golden_path);
+    std::filesystem::remove_all(options.diff_dir);
+
+    // a case run from the lcd off segment alone hashes the same as the frame above
+    write_text(options.list_path, rom_path + " 5 movie=" + on_path + "\n" +
+                                  rom_path + " 5 movie=" + off_path + " checkpoints=1,5\n");
+    options.update_golden = true;
+    CHECK(run_regressions(options));
+    std::string golden = read_text(options.golden_path);
+    CHECK(golden.find(fmt::format("{} 5 {:016x}", on_path, blank)) == std::string::npos);
+    CHECK(golden.find(fmt::format("{} 1 {:016x}", off_path, blank)) != std::string::npos);
+    CHECK(golden.find(fmt::format("{} 5 {:016x}", off_path, blank)) != std::string::npos);
+
+    options.update_golden = false;
+    CHECK(run_regressions(options));
+  }
+}
+
+int main() {
+  test_list();
+  test_golden();
+  test_lcd_off();
+  return check_result();
+}